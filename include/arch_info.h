@@ -34,6 +34,7 @@ enum Model {
 
 extern enum Model model;
 extern const char *model_name;
+extern const char *cmdline;
 extern uint32_t mem_total;
 extern uint32_t initrd_start;
 extern uint32_t initrd_size;
@@ -43,8 +44,14 @@ extern uint32_t led_pwr_pin;
 
 enum {
     NO_LED = ~0U, // pin value when LED does not exist
+    PERIPHERAL_SIZE = 0x01000000, // block at peripheral_base
+    LOCAL_PERIPHERAL_BASE = 0x40000000, // per core registers on the Pi 2
+    LOCAL_PERIPHERAL_SIZE = 0x00040000,
 };
 
+// find token in string and return it or return NULL
+const char *find(const char *str, const char *token);
+
 typedef struct Atag Atag;
 
 EXPORT extern Atag *atags; // in start.S
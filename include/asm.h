@@ -34,7 +34,7 @@ __BEGIN_DECLS
 static inline void isb(void) {
     // ARMv7
     // asm volatile ("isb");
-    asm volatile ("mcr p15, 0, r12, c7, c5, 4");
+    asm volatile ("mcr p15, 0, r12, c7, c5, 4" : : : "memory");
 }
 
 /* Data Synchronization Barrier
@@ -49,7 +49,7 @@ static inline void isb(void) {
 static inline void dsb(void) {
     // ARMv7
     // asm volatile ("dsb");
-    asm volatile ("mcr p15, 0, r12, c7, c10, 4");
+    asm volatile ("mcr p15, 0, r12, c7, c10, 4" : : : "memory");
 }
 
 /* Data Memory Barrier
@@ -62,7 +62,7 @@ static inline void dsb(void) {
 static inline void dmb(void) {
     // ARMv7
     // asm volatile ("dmb");
-    asm volatile ("mcr p15, 0, r12, c7, c10, 5");
+    asm volatile ("mcr p15, 0, r12, c7, c10, 5" : : : "memory");
 }
 __END_DECLS
 
@@ -28,6 +28,12 @@ __BEGIN_DECLS
 #define VIRT_TO_PHYS           0x80000000
 #define PHYS_TO_VIRT           0x80000000
 
+#define USER_SPACE_END         0x40000000 /* TTBR0 (TTBCR.N = 2) maps 0 - 1G */
+
+/* kernel address space handed out by KVA, minus the fixed windows below */
+#define KERNEL_VA_START        0xC0000000
+#define KERNEL_VA_END          0xFFF00000 /* last MB kept for high vectors */
+
 #define CORE0_SVC_STACK        0xC0000000 /* 16k stack for SVC mode */
 #define CORE0_SYS_STACK        0xC0008000 /* 16k stack for SYS mode */
 #define CORE0_ABORT_STACK      0xC0010000 /* 16k stack for ABORT mode */
@@ -35,36 +41,56 @@ __BEGIN_DECLS
 #define CORE0_OTHER_LEAFTABLES 0xC0400000 /* 1M target leaftables on copy */
 #define CORE0_PRIVATE          0xC0800000
     
-#define CORE1_SVC_STACK        0xC0000000 /* 16k stack for SVC mode */
-#define CORE1_SYS_STACK        0xC0008000 /* 16k stack for SYS mode */
-#define CORE1_ABORT_STACK      0xC0010000 /* 16k stack for ABORT mode */
+#define CORE1_SVC_STACK        0xC1000000 /* 16k stack for SVC mode */
+#define CORE1_SYS_STACK        0xC1008000 /* 16k stack for SYS mode */
+#define CORE1_ABORT_STACK      0xC1010000 /* 16k stack for ABORT mode */
 #define CORE1_OTHER_PAGETABLE  0xC1200000 /* 4k target pagetable on copy */
 #define CORE1_OTHER_LEAFTABLES 0xC1400000 /* 1M target leaftables on copy */
 #define CORE1_PRIVATE          0xC1800000
     
-#define CORE2_SVC_STACK        0xC0000000 /* 16k stack for SVC mode */
-#define CORE2_SYS_STACK        0xC0008000 /* 16k stack for SYS mode */
-#define CORE2_ABORT_STACK      0xC0010000 /* 16k stack for ABORT mode */
+#define CORE2_SVC_STACK        0xC2000000 /* 16k stack for SVC mode */
+#define CORE2_SYS_STACK        0xC2008000 /* 16k stack for SYS mode */
+#define CORE2_ABORT_STACK      0xC2010000 /* 16k stack for ABORT mode */
 #define CORE2_OTHER_PAGETABLE  0xC2200000 /* 4k target pagetable on copy */
 #define CORE2_OTHER_LEAFTABLES 0xC2400000 /* 1M target leaftables on copy */
 #define CORE2_PRIVATE          0xC2800000
     
-#define CORE3_SVC_STACK        0xC0000000 /* 16k stack for SVC mode */
-#define CORE3_SYS_STACK        0xC0008000 /* 16k stack for SYS mode */
-#define CORE3_ABORT_STACK      0xC0010000 /* 16k stack for ABORT mode */
+#define CORE3_SVC_STACK        0xC3000000 /* 16k stack for SVC mode */
+#define CORE3_SYS_STACK        0xC3008000 /* 16k stack for SYS mode */
+#define CORE3_ABORT_STACK      0xC3010000 /* 16k stack for ABORT mode */
 #define CORE3_OTHER_PAGETABLE  0xC3200000 /* 4k target pagetable on copy */
 #define CORE3_OTHER_LEAFTABLES 0xC3400000 /* 1M target leaftables on copy */
 #define CORE3_PRIVATE          0xC3800000
 
-#define KERNEL_GPIO            0xD0000000 /* 4k GPIO registers (LED) */
-#define KERNEL_UART            0xD0002000 /* 4k UART registers */
-#define KERNEL_TIMER           0xD0004000 /* 4k system TIMER registers */
-#define KERNEL_CORE_MAIL       0xD0006000 /* 4k core mail boxes */
-#define KERNEL_VC_MAIL         0xD0008000 /* 4k VC mail boxes */
-#define KERNEL_IRQ             0xD000A000 /* 4k IRQ registers */
+/* offsets into the COREn_PRIVATE windows */
+#define PRIVATE_FRAMES         0x00000000 /* 4k free frame magazine */
+#define PRIVATE_SLAB           0x00001000 /* 4k kernel heap object cache */
+
+/* size of the COREn_*_STACK stacks, the 16k after each stay unmapped */
+#define CORE_STACK_SIZE        0x00004000
+
+#define COMMON_TIME_PAGE       0xD0000000 /* 4k clock parameters, user read-only */
+#define COMMON_TIME_COUNTER    0xD0001000 /* 4k system timer, user read-only */
 #define KERNEL_PAGETABLE       0xD0200000 /* 16k (first 8k unused) */
-#define KERNEL_LEAFTABLES      0xD0400000 /* 4M (first 2M unmapped) */
-#define PER_PAGE_INFO          0xE0000000 /* 4M (size ram / 1024) */
+#define KERNEL_LEAFTABLES      0xD0400000 /* 4M, 4k for every 4M in use */
+#define KERNEL_PERIPHERALS     0xD1000000 /* 16M peripheral block, sections */
+#define KERNEL_LOCAL_PERIPHERALS 0xD2000000 /* 1M Pi 2 per core registers */
+#define PER_PAGE_INFO          0xE0000000 /* 4M (size ram / 512) */
+
+/* devices inside the peripheral windows */
+#define KERNEL_TIMER           (KERNEL_PERIPHERALS + 0x00003000) /* system TIMER */
+#define KERNEL_IRQ             (KERNEL_PERIPHERALS + 0x0000B000) /* IRQ */
+#define KERNEL_VC_MAIL         (KERNEL_PERIPHERALS + 0x0000B880) /* VC mail boxes */
+#define KERNEL_GPIO            (KERNEL_PERIPHERALS + 0x00200000) /* GPIO (LED) */
+#define KERNEL_UART            (KERNEL_PERIPHERALS + 0x00201000) /* UART */
+#define KERNEL_CORE_MAIL       (KERNEL_LOCAL_PERIPHERALS + 0x00000000) /* core mail boxes */
+
+/* frames of 4 LeafTables reserved in boot.S, the first BOOT_LEAF_GROUPS are
+ * used by boot.S itself, the rest serve map() until the frame allocator is
+ * up
+ */
+#define BOOT_LEAF_GROUPS       4
+#define BOOT_LEAF_FRAMES       8
 
 __END_DECLS
 
@@ -48,6 +48,28 @@ public:
     Container & prev() {
 	return *prev_;
     }
+
+    // insert into the list of other, just before other
+    void link_before(Container &other) {
+	List &list = other;
+	next_ = &other;
+	prev_ = list.prev_;
+	prev_->List::next_ = static_cast<Container *>(this);
+	list.prev_ = static_cast<Container *>(this);
+    }
+
+    // remove from the list, afterwards the element is a list of its own
+    void unlink() {
+	next_->List::prev_ = prev_;
+	prev_->List::next_ = next_;
+	next_ = static_cast<Container *>(this);
+	prev_ = static_cast<Container *>(this);
+    }
+
+    // element is not linked to any other
+    bool alone() const {
+	return next_ == static_cast<const Container *>(this);
+    }
 private:
     List(const List &&) = delete;
     List && operator =(const List &&) = delete;
@@ -86,6 +108,21 @@ public:
     Container & prev() {
 	return List<Container, Id>::prev();
     }
+
+    template<class Id>
+    void link_before(Container &other) {
+	List<Container, Id>::link_before(other);
+    }
+
+    template<class Id>
+    void unlink() {
+	List<Container, Id>::unlink();
+    }
+
+    template<class Id>
+    bool alone() const {
+	return List<Container, Id>::alone();
+    }
 };
 
 template<class Container>
@@ -0,0 +1,45 @@
+/* Copyright (C) 2015 Goswin von Brederlow <goswin-v-b@web.de>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+/* Freestanding string functions
+ *
+ * Implemented in assembly in common/ and linked into .text.common, so the
+ * kernel and user code share them. boot has its own physical copy of
+ * memset and bzero as boot_memset and boot_bzero.
+ */
+
+#ifndef STRING_H
+#define STRING_H 1
+
+#include <stddef.h>
+#include <sys/cdefs.h>
+
+__BEGIN_DECLS
+// fill n bytes at dst with the byte c, returns dst
+void * memset(void *dst, int c, size_t n);
+
+// fill n bytes at dst with zero
+void bzero(void *dst, size_t n);
+
+// copy n bytes from src to dst, the ranges must not overlap, returns dst
+void * memcpy(void *dst, const void *src, size_t n);
+
+// copy n bytes from src to dst, the ranges may overlap, returns dst
+void * memmove(void *dst, const void *src, size_t n);
+__END_DECLS
+
+#endif // #ifndef STRING_H
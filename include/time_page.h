@@ -0,0 +1,63 @@
+/* Copyright (C) 2015 Goswin von Brederlow <goswin-v-b@web.de>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+/* Time page shared with user space
+ *
+ * The kernel keeps the parameters of its clock source in a page mapped
+ * user read-only at COMMON_TIME_PAGE. monotonic_ns() in .text.common reads
+ * the counter and the page and converts without entering the kernel:
+ *
+ *     ns = base_ns + (counter - base_ticks) * mult >> shift
+ *
+ * The kernel moves the base forward now and then. seq is odd while it
+ * writes, readers retry when it was odd or changed during their read.
+ */
+
+#ifndef TIME_PAGE_H
+#define TIME_PAGE_H 1
+
+#include <sys/cdefs.h>
+
+#define TIME_PAGE_SEQ          0x00
+#define TIME_PAGE_SOURCE       0x04
+#define TIME_PAGE_MULT         0x08
+#define TIME_PAGE_SHIFT        0x0C
+#define TIME_PAGE_BASE_TICKS   0x10
+#define TIME_PAGE_BASE_NS      0x18
+
+#define TIME_SOURCE_SYSTEM_TIMER 0 /* 1MHz, user mapped at COMMON_TIME_COUNTER */
+#define TIME_SOURCE_CNTPCT     1 /* generic timer, Pi 2 */
+
+#ifndef ASSEMBLY
+#include <stdint.h>
+
+__BEGIN_DECLS
+struct TimePage {
+    volatile uint32_t seq;
+    uint32_t source;
+    uint32_t mult; // ticks to ns
+    uint32_t shift;
+    uint64_t base_ticks;
+    uint64_t base_ns;
+};
+
+// monotonic time in ns since power on, callable from kernel and user mode
+uint64_t monotonic_ns(void);
+__END_DECLS
+#endif // #ifndef ASSEMBLY
+
+#endif // #ifndef TIME_PAGE_H
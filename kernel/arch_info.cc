@@ -20,9 +20,12 @@
 
 #include "arch_info.h"
 #include <stddef.h>
+#include "boottime.h"
 #include "kprintf.h"
 #include "memory/pagetable.h"
 #include "memory/PhysAddr.h"
+#include "memory/physmap.h"
+#include "peripherals.h"
 #include "fixed_addresses.h"
 #include "init_priorities.h"
 
@@ -102,8 +105,12 @@ CONSTRUCTOR(ARCH_INFO) {
     while (atag) {
         switch (atag->tag) {
         case MEM: {
-            // assumes atag->mem.start == 0
-            mem_total = atag->mem.size;
+            PhysMap::add(atag->mem.start, atag->mem.size,
+			 PhysMap::MEM_USABLE);
+            // end of RAM, there can be more than one MEM tag
+            if (atag->mem.start + atag->mem.size > mem_total) {
+                mem_total = atag->mem.start + atag->mem.size;
+            }
             break;
         }
         case INITRD2: {
@@ -144,15 +151,9 @@ CONSTRUCTOR(ARCH_INFO) {
         atag = next(atag);
     }
 
-    // map GPIO, UART, IRQ and system TIMER peripherals at fixed locations
-    Memory::map(Memory::PhysAddr(peripheral_base + 0x00200000),
-		(const void * const)KERNEL_GPIO, Memory::KERNEL_PERIPHERAL);
-    Memory::map(Memory::PhysAddr(peripheral_base + 0x00201000),
-		(const void * const)KERNEL_UART, Memory::KERNEL_PERIPHERAL);
-    Memory::map(Memory::PhysAddr(peripheral_base + 0x0000B000),
-		(const void * const)KERNEL_IRQ, Memory::KERNEL_PERIPHERAL);
-    Memory::map(Memory::PhysAddr(peripheral_base + 0x00003000),
-		(const void * const)KERNEL_TIMER, Memory::KERNEL_PERIPHERAL);
+    // map all peripherals at fixed locations
+    Peripheral::map_windows();
+    BootTime::timer_mapped();
     kprintf("\nDetected '%s'\n", model_name);
     kprintf("Memory      : %#8.8lx\n", mem_total);
     kprintf("Initrd start: %#8.8lx\n", initrd_start);
@@ -166,6 +167,7 @@ CONSTRUCTOR(ARCH_INFO_POST) {
     kprintf("Initrd start: %#8.8lx\n", initrd_start);
     kprintf("Initrd size : %#8.8lx\n", initrd_size);
     kprintf("Commandline : '%s'\n", cmdline);
+    Peripheral::report();
 } CONSTRUCTOR_END
 
 __END_NAMESPACE(Kernel);
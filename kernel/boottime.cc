@@ -0,0 +1,116 @@
+/* Copyright (C) 2015 Goswin von Brederlow <goswin-v-b@web.de>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+/* Boot time measurement
+ */
+
+#include "boottime.h"
+#include "arch_info.h"
+#include "kprintf.h"
+#include "timer.h"
+
+__BEGIN_NAMESPACE(Kernel);
+__BEGIN_NAMESPACE(BootTime);
+
+struct Record {
+    const char *name;
+    uint64_t start;
+    uint64_t end;    // 0 while the stage is running
+    uint32_t depth;  // number of enclosing stages
+    bool partial;    // started before the timer was mapped
+};
+
+// only the boot core runs stages, no locking needed
+static Record records[MAX_STAGES];
+static uint32_t num_records;
+static uint32_t open_stages; // depth of the next stage
+static bool timer_ready;
+
+static uint64_t now() {
+    return timer_ready ? Timer::count() : 0;
+}
+
+Stage::Stage(const char *name) : slot_(MAX_STAGES) {
+    if (num_records < MAX_STAGES) {
+	slot_ = num_records++;
+	Record &record = records[slot_];
+	record.name = name;
+	record.depth = open_stages;
+	record.partial = !timer_ready;
+	record.start = now();
+	record.end = 0;
+    }
+    ++open_stages;
+}
+
+Stage::~Stage() {
+    --open_stages;
+    if (slot_ < MAX_STAGES) {
+	records[slot_].end = now();
+    }
+}
+
+void timer_mapped() {
+    timer_ready = true;
+    uint64_t t = now();
+    for (uint32_t i = 0; i < num_records; ++i) {
+	if (records[i].partial) records[i].start = t;
+    }
+}
+
+// name indented by depth and padded to a column
+static void print_name(const char *name, uint32_t depth) {
+    uint32_t len = 2 * depth;
+    for (uint32_t i = 0; i < len; ++i) kprintf(" ");
+    for (const char *p = name; *p; ++p) ++len;
+    kprintf("%s", name);
+    for (; len < 24; ++len) kprintf(" ");
+}
+
+void report() {
+    if (cmdline != nullptr && find(cmdline, "boottime=raw")) {
+	for (uint32_t i = 0; i < num_records; ++i) {
+	    const Record &record = records[i];
+	    kprintf("boottime,%lu,%s,%llu,%llu\n", record.depth, record.name,
+		    record.start, record.end);
+	}
+	return;
+    }
+
+    if (num_records == 0) return;
+    uint64_t first = records[0].start, last = first;
+    kprintf("\nBoot time (usec), first stage at %llu\n", first);
+    for (uint32_t i = 0; i < num_records; ++i) {
+	const Record &record = records[i];
+	print_name(record.name, record.depth);
+	if (record.end == 0) {
+	    kprintf(" +%8llu  running\n", record.start - first);
+	    continue;
+	}
+	if (record.end > last) last = record.end;
+	kprintf(" +%8llu %8llu%s\n", record.start - first,
+		record.end - record.start, record.partial ? " partial" : "");
+    }
+    print_name("total", 0);
+    kprintf("           %8llu\n", last - first);
+    if (num_records == MAX_STAGES) {
+	kprintf("table full, later stages were not recorded\n");
+    }
+}
+
+__END_NAMESPACE(BootTime);
+__END_NAMESPACE(Kernel);
@@ -0,0 +1,65 @@
+/* Copyright (C) 2015 Goswin von Brederlow <goswin-v-b@web.de>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+/* Boot time measurement
+ *
+ * Every CONSTRUCTOR() and the stages of kernel_main() are wrapped in a
+ * Stage that records the system timer at entry and exit in a static table.
+ * Nothing is printed while booting, report() dumps the table once the UART
+ * is up. With "boottime=raw" on the command line it prints one
+ * "boottime,<depth>,<name>,<start>,<end>" line per stage instead.
+ *
+ * The system timer is only mapped halfway through ARCH_INFO. Stages entered
+ * before that get the time of timer_mapped() as start and are marked as
+ * partial.
+ */
+
+#ifndef KERNEL_BOOTTIME_H
+#define KERNEL_BOOTTIME_H 1
+
+#include <stdint.h>
+#include <sys/cdefs.h>
+
+__BEGIN_NAMESPACE(Kernel);
+__BEGIN_NAMESPACE(BootTime);
+
+enum {
+    MAX_STAGES = 32, // later stages are not recorded
+};
+
+// time a stage for the lifetime of the object, stages can nest
+class Stage {
+public:
+    explicit Stage(const char *name);
+    ~Stage();
+
+    Stage(const Stage &) = delete;
+    Stage & operator =(const Stage &) = delete;
+private:
+    uint32_t slot_; // entry in the table or MAX_STAGES when full
+};
+
+// the system timer can be read from now on
+void timer_mapped();
+
+// print all stages recorded so far
+void report();
+
+__END_NAMESPACE(BootTime);
+__END_NAMESPACE(Kernel);
+
+#endif // #ifndef KERNEL_BOOTTIME_H
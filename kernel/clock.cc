@@ -0,0 +1,156 @@
+/* Copyright (C) 2015 Goswin von Brederlow <goswin-v-b@web.de>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+/* Clock source
+ */
+
+#include "clock.h"
+#include <stddef.h>
+#include <string.h>
+#include "arch_info.h"
+#include "assert.h"
+#include "init_priorities.h"
+#include "kprintf.h"
+#include "peripherals.h"
+#include "time_page.h"
+#include "wheel.h"
+#include "memory/frames.h"
+#include "memory/pagetable.h"
+
+__BEGIN_NAMESPACE(Kernel);
+__BEGIN_NAMESPACE(Clock);
+
+enum {
+    SYSTEM_TIMER_HZ = 1000000,
+    NS_PER_SEC = 1000000000,
+    USEC_PER_SEC = 1000000,
+    // keeps the scaled deltas of monotonic_ns() short
+    TIME_PAGE_REFRESH_USEC = 60 * USEC_PER_SEC,
+    CNTKCTL_PL0PCTEN = 1U << 0, // user mode may read CNTPCT
+};
+
+bool generic_timer;
+uint32_t frequency = SYSTEM_TIMER_HZ;
+Scale ticks_to_ns, ns_to_ticks, ticks_to_usec, usec_to_ticks;
+
+/* factors for from to to
+ * The largest shift that keeps mult in 32 bit gives the most precise
+ * result, slowing down needs more than 32 bits of fraction.
+ */
+static Scale make_scale(uint32_t from, uint32_t to) {
+    uint32_t shift = 32;
+    uint64_t mult = (uint64_t(to) << shift) / from;
+    while (mult > 0xFFFFFFFFULL) {
+	--shift;
+	mult = (uint64_t(to) << shift) / from;
+    }
+    uint64_t rem = (uint64_t(to) << shift) - mult * from;
+    while (mult < 0x80000000ULL && shift < 63) {
+	// one more bit of the quotient
+	rem <<= 1;
+	mult <<= 1;
+	if (rem >= from) {
+	    rem -= from;
+	    ++mult;
+	}
+	++shift;
+    }
+    return Scale{uint32_t(mult), shift};
+}
+
+void init_core() {
+    if (!generic_timer) return;
+    uint32_t t;
+    asm volatile ("mrc p15, 0, %0, c14, c1, 0" : "=r"(t)); // CNTKCTL
+    t |= CNTKCTL_PL0PCTEN;
+    asm volatile ("mcr p15, 0, %0, c14, c1, 0" : : "r"(t));
+}
+
+// common/time.S uses the offsets
+static_assert(offsetof(TimePage, source) == TIME_PAGE_SOURCE, "time page");
+static_assert(offsetof(TimePage, mult) == TIME_PAGE_MULT, "time page");
+static_assert(offsetof(TimePage, shift) == TIME_PAGE_SHIFT, "time page");
+static_assert(offsetof(TimePage, base_ticks) == TIME_PAGE_BASE_TICKS,
+	      "time page");
+static_assert(offsetof(TimePage, base_ns) == TIME_PAGE_BASE_NS, "time page");
+
+// kernel alias of the time page, only the timer IRQ of core 0 writes
+static TimePage *time_page;
+
+/* move the base of the time page to now
+ * The new base_ns is what monotonic_ns() returned for now with the old
+ * base, so user time never jumps backwards.
+ */
+static void refresh_time_page(Timer::Event *event, void *arg) {
+    (void)arg;
+    uint64_t before = monotonic_ns();
+    uint64_t now = ticks();
+    uint64_t ns = time_page->base_ns
+	+ scale(now - time_page->base_ticks,
+		Scale{time_page->mult, time_page->shift});
+    time_page->seq = time_page->seq + 1;
+    dmb();
+    time_page->base_ticks = now;
+    time_page->base_ns = ns;
+    dmb();
+    time_page->seq = time_page->seq + 1;
+    assert(monotonic_ns() >= before);
+    Timer::add(event, event->deadline() + TIME_PAGE_REFRESH_USEC);
+}
+
+CONSTRUCTOR(CLOCK) {
+    if (model == RASPBERRY_PI_2) {
+	// the firmware sets CNTFRQ to the crystal, 19.2MHz
+	asm volatile ("mrc p15, 0, %0, c14, c0, 0" : "=r"(frequency));
+	generic_timer = frequency != 0;
+    }
+    if (!generic_timer) frequency = SYSTEM_TIMER_HZ;
+    ticks_to_ns = make_scale(frequency, NS_PER_SEC);
+    ns_to_ticks = make_scale(NS_PER_SEC, frequency);
+    ticks_to_usec = make_scale(frequency, USEC_PER_SEC);
+    usec_to_ticks = make_scale(USEC_PER_SEC, frequency);
+    init_core();
+    kprintf("Clock       : %s at %lu Hz\n",
+	    generic_timer ? "CNTPCT" : "system timer", frequency);
+} CONSTRUCTOR_END
+
+CONSTRUCTOR(TIME_PAGE) {
+    Memory::PhysAddr frame = Memory::alloc_frame();
+    assert(frame.valid());
+    time_page = (TimePage *)Memory::phys_to_virt(frame);
+    bzero(time_page, Memory::PAGE_SIZE);
+    time_page->source =
+	generic_timer ? TIME_SOURCE_CNTPCT : TIME_SOURCE_SYSTEM_TIMER;
+    // common/time.S only shifts within 32 bit
+    assert(ticks_to_ns.shift < 32);
+    time_page->mult = ticks_to_ns.mult;
+    time_page->shift = ticks_to_ns.shift;
+    time_page->base_ticks = ticks();
+    time_page->base_ns = to_ns(time_page->base_ticks);
+    Memory::map(frame, (const void *)COMMON_TIME_PAGE, Memory::COMMON_READ);
+    if (!generic_timer) {
+	Memory::PhysAddr counter(Peripheral::phys(Peripheral::TIMER_BASE));
+	Memory::map(counter, (const void *)COMMON_TIME_COUNTER,
+		    Memory::COMMON_PERIPHERAL);
+    }
+
+    static Timer::Event refresh(refresh_time_page, nullptr);
+    Timer::add_after(&refresh, TIME_PAGE_REFRESH_USEC);
+} CONSTRUCTOR_END
+
+__END_NAMESPACE(Clock);
+__END_NAMESPACE(Kernel);
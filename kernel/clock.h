@@ -0,0 +1,104 @@
+/* Copyright (C) 2015 Goswin von Brederlow <goswin-v-b@web.de>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+/* Clock source
+ *
+ * Monotonic 64 bit time since power on. On the Raspberry Pi 2 the ARM
+ * generic timer CNTPCT is read with a single MRRC, which can not tear. The
+ * older models read the 1MHz system timer with a hi/lo/hi sequence that
+ * retries when the low word wraps between the loads.
+ *
+ * Conversions between ticks and ns or usec are one multiply and a shift
+ * with factors computed from the frequency at boot, no division.
+ *
+ * The same parameters are published to user space in the time page (see
+ * time_page.h), so monotonic_ns() does not need a system call.
+ */
+
+#ifndef KERNEL_CLOCK_H
+#define KERNEL_CLOCK_H 1
+
+#include <stdint.h>
+#include <sys/cdefs.h>
+#include "timer.h"
+
+__BEGIN_NAMESPACE(Kernel);
+__BEGIN_NAMESPACE(Clock);
+
+// value * mult >> shift
+struct Scale {
+    uint32_t mult;
+    uint32_t shift;
+};
+
+extern bool generic_timer; // ticks from CNTPCT instead of the system timer
+extern uint32_t frequency; // ticks per second
+extern Scale ticks_to_ns, ns_to_ticks, ticks_to_usec, usec_to_ticks;
+
+// 64 bit times 32 bit without losing the upper bits of the product
+static inline uint64_t scale(uint64_t value, Scale s) {
+    uint64_t lo = uint64_t(uint32_t(value)) * s.mult;
+    uint64_t hi = (value >> 32) * s.mult;
+    if (s.shift >= 32) return (hi >> (s.shift - 32)) + (lo >> s.shift);
+    return (hi << (32 - s.shift)) + (lo >> s.shift);
+}
+
+// current time in ticks of the clock source
+static inline uint64_t ticks() {
+    if (generic_timer) {
+	uint32_t lo, hi;
+	// keep earlier instructions from reading the counter late, the CP15
+	// isb because the ARMv6 kernel has to assemble this too
+	asm volatile ("mcr p15, 0, %2, c7, c5, 4\n"
+		      "\tmrrc p15, 0, %0, %1, c14"
+		      : "=r"(lo), "=r"(hi) : "r"(0) : "memory");
+	return (uint64_t(hi) << 32) | lo;
+    }
+    return Timer::count();
+}
+
+static inline uint64_t to_ns(uint64_t t) {
+    return scale(t, ticks_to_ns);
+}
+
+static inline uint64_t to_usec(uint64_t t) {
+    return scale(t, ticks_to_usec);
+}
+
+static inline uint64_t from_ns(uint64_t ns) {
+    return scale(ns, ns_to_ticks);
+}
+
+static inline uint64_t from_usec(uint64_t usec) {
+    return scale(usec, usec_to_ticks);
+}
+
+static inline uint64_t now_ns() {
+    return to_ns(ticks());
+}
+
+static inline uint64_t now_usec() {
+    return to_usec(ticks());
+}
+
+// let user mode of this core read the counter of the clock source
+void init_core();
+
+__END_NAMESPACE(Clock);
+__END_NAMESPACE(Kernel);
+
+#endif // ##ifndef KERNEL_CLOCK_H
@@ -0,0 +1,70 @@
+/* Copyright (C) 2015 Goswin von Brederlow <goswin-v-b@web.de>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+/* Per core helpers
+ */
+
+#ifndef KERNEL_CORE_H
+#define KERNEL_CORE_H 1
+
+#include <stdint.h>
+#include <sys/cdefs.h>
+#include "arch_info.h"
+#include "fixed_addresses.h"
+
+__BEGIN_NAMESPACE(Kernel);
+__BEGIN_NAMESPACE(Core);
+
+enum {
+    MAX_CORES = 4,
+};
+
+// number of cores of the board
+static inline uint32_t count() {
+    return (model == RASPBERRY_PI_2) ? 4 : 1;
+}
+
+// number of the core we are running on
+static inline uint32_t id() {
+    if (model != RASPBERRY_PI_2) return 0;
+    uint32_t t;
+    asm volatile ("mrc p15, 0, %[t], c0, c0, 5" : [t] "=r" (t));
+    return t & 0x3;
+}
+
+// address of something in the COREn_PRIVATE window of a core
+static inline void * private_addr(uint32_t core, uint32_t offset) {
+    return (void *)(CORE0_PRIVATE + core * (CORE1_PRIVATE - CORE0_PRIVATE)
+		    + offset);
+}
+
+// window for the Pagetable of another address space while copying it
+static inline void * other_pagetable(uint32_t core) {
+    return (void *)(CORE0_OTHER_PAGETABLE
+		    + core * (CORE1_OTHER_PAGETABLE - CORE0_OTHER_PAGETABLE));
+}
+
+// window for the LeafTables of another address space while copying it
+static inline void * other_leaftables(uint32_t core) {
+    return (void *)(CORE0_OTHER_LEAFTABLES
+		    + core * (CORE1_OTHER_LEAFTABLES - CORE0_OTHER_LEAFTABLES));
+}
+
+__END_NAMESPACE(Core);
+__END_NAMESPACE(Kernel);
+
+#endif // ##ifndef KERNEL_CORE_H
@@ -23,6 +23,8 @@
 #include "arch_info.h"
 #include "kprintf.h"
 #include "init_priorities.h"
+#include "fixed_addresses.h"
+#include "memory/AddressSpace.h"
 
 __BEGIN_NAMESPACE(Kernel);
 
@@ -140,9 +142,13 @@ uint32_t dfar_read(void) {
     return t;
 }
 
+// FS[4] is bit 10, FS[3:0] bits 3:0
+static uint32_t fault_status(uint32_t fsr) {
+    return ((fsr & (1 << 10)) >> 6) | (fsr & 0xF);
+}
+
 void decode_fault_status(uint32_t fsr) {
-    uint32_t status = ((fsr & (1 << 10)) >> 6) | (fsr & 0x7);
-    switch (status) {
+    switch (fault_status(fsr)) {
     case 0b00001:
 	kprintf("alignment fault\n");
 	break;
@@ -214,8 +220,12 @@ void set_vbar(uint32_t *base) {
 		  :: [base] "r" (base));
 }
 
-CONSTRUCTOR(EXCEPTIONS) {
+void init_core() {
     set_vbar(exception_vector);
+}
+
+CONSTRUCTOR(EXCEPTIONS) {
+    init_core();
 } CONSTRUCTOR_END
 
 void handler_reset(Regs *regs, uint32_t num) {
@@ -252,11 +262,35 @@ void handler_prefetch_abort(Regs *regs, uint32_t num) {
     regs->lr += 4;
 }
 
+/* map user memory on demand
+ * Translation and permission faults in user space go to the regions of
+ * the active AddressSpace. Returns true when the access can be retried.
+ */
+static bool resolve_fault(uint32_t fsr, uint32_t far) {
+    if (far >= USER_SPACE_END) return false;
+    switch (fault_status(fsr)) {
+    case 0b00101: // first level translation fault
+    case 0b00111: // second level translation fault
+    case 0b01101: // first level permission fault
+    case 0b01111: // second level permission fault
+	break;
+    default:
+	return false;
+    }
+    Memory::AddressSpace *space = Memory::AddressSpace::current();
+    return space != nullptr
+	&& space->handle_fault((const void *)far, fsr & (1 << 11));
+}
+
 void handler_data_abort(Regs *regs, uint32_t num) {
-    kprintf("%s: Regs @ %p\n", EXCEPTION[num], regs);
-    dump_regs(regs);
     uint32_t dfsr = dfsr_read();
     uint32_t dfar = dfar_read();
+    if (resolve_fault(dfsr, dfar)) {
+	// retry the instruction
+	return;
+    }
+    kprintf("%s: Regs @ %p\n", EXCEPTION[num], regs);
+    dump_regs(regs);
     kprintf("data abort on %s, ", (dfsr & (1 << 11)) ? "write" : "read");
     decode_fault_status(dfsr);
     kprintf("DFAR %#8.8lx (fault address)\n", dfar);
@@ -51,4 +51,11 @@ void dump_regs(const Regs *regs);
 __END_NAMESPACE(Kernel);
 __END_DECLS;
 
+__BEGIN_NAMESPACE(Kernel);
+__BEGIN_NAMESPACE(Exceptions);
+// point the vector base of the calling core at the exception vector
+void init_core();
+__END_NAMESPACE(Exceptions);
+__END_NAMESPACE(Kernel);
+
 #endif // ##ifndef KERNEL_EXCEPTIONS_H
@@ -53,7 +53,7 @@ volatile uint32_t * GPIO_reg(enum GPIO_Reg reg) = delete;
 
 template<>
 volatile uint32_t * GPIO_reg<Peripheral::GPIO_BASE>(enum GPIO_Reg reg) {
-    return (volatile uint32_t *)(KERNEL_GPIO + reg);
+    return Peripheral::registers(Peripheral::GPIO_BASE, reg);
 }
 
 template<>
@@ -22,17 +22,32 @@
 #ifndef KERNEL_INIT_PRIORITIES_H
 #define KERNEL_INIT_PRIORITIES_H 1
 
+#include "boottime.h"
+
 enum INIT_PRIORITIES {
     INIT_ARCH_INFO  = 1000,
     INIT_LED,
     INIT_UART,
     INIT_ARCH_INFO_POST,
+    INIT_CLOCK,
     INIT_EXCEPTIONS,
+    INIT_CACHE,
+    INIT_PHYS_MAP,
+    INIT_FRAMES,
+    INIT_SLAB,
+    INIT_KVA,
+    INIT_ZERO_PAGE,
+    INIT_ADDRESS_SPACE_TEST,
+    INIT_TIMER_WHEEL,
+    INIT_TIMER_WHEEL_TEST,
+    INIT_TIME_PAGE,
 };
 
+// the body is timed as a boot stage named after the constructor
 #define CONSTRUCTOR(name)						\
     void __attribute__((constructor(__CONCAT(INIT_,name))))		\
     __CONCAT(name,_init)(void) {					\
+    ::Kernel::BootTime::Stage boot_stage(#name);			\
     do
 
 #define CONSTRUCTOR_END while(0); }
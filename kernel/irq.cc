@@ -20,9 +20,11 @@
 
 #include "irq.h"
 #include "arch_info.h"
+#include "core.h"
 #include "kprintf.h"
 #include "exceptions.h"
 #include "peripherals.h"
+#include "smp.h"
 #include "timer.h"
 
 __BEGIN_NAMESPACE(Kernel);
@@ -46,17 +48,34 @@ volatile uint32_t * IRQ_reg(enum IRQ_Reg reg) = delete;
 
 template<>
 volatile uint32_t * IRQ_reg<Peripheral::IRQ_BASE>(enum IRQ_Reg reg) {
-    return (volatile uint32_t *)(KERNEL_IRQ + reg);
+    return Peripheral::registers(Peripheral::IRQ_BASE, reg);
 }
 
 void handler_irq(Regs *regs, uint32_t num) {
     PERIPHERAL(IRQ_BASE);
 
     (void)num;
-    volatile uint32_t *pending1 = IRQ_reg<BASE>(IRQ_PENDING1);
-    if ((*pending1 & (1U << 1)) != 0) {
+    if (Core::id() != 0) {
+	// all GPU interrupts go to core 0
+	SMP::handle_irq<BASE>();
+	return;
+    }
+    uint32_t pending1 = *IRQ_reg<BASE>(IRQ_PENDING1);
+    bool handled = false;
+    if ((pending1 & (1U << IRQ_TIMER1)) != 0) {
 	Timer::handle_timer1<BASE>();
-    } else {
+	handled = true;
+    }
+    if (Core::count() > 1 && SMP::handle_irq<BASE>()) {
+	// kicks from other cores
+	handled = true;
+    }
+    if ((pending1 & (1U << IRQ_TIMER3)) != 0) {
+	// may switch threads, so it goes last
+	Timer::handle_timer3<BASE>();
+	handled = true;
+    }
+    if (!handled) {
 	kprintf("%s: Regs @ %p\n", "IRQ", regs);
 	dump_regs(regs);
     }
@@ -95,6 +114,18 @@ void disable_irqs(void) {
     cpsr_write_c(cpsr);
 }
 
+uint32_t save_irqs(void) {
+    uint32_t cpsr = cpsr_read();
+    cpsr_write_c(cpsr | CPSR_IRQ_DISABLE);
+    return cpsr & CPSR_IRQ_DISABLE;
+}
+
+void restore_irqs(uint32_t state) {
+    if (state == 0) {
+	enable_irqs();
+    }
+}
+
 template<>
 void enable_irq<Peripheral::IRQ_BASE>(enum IRQ irq) {
     BASE(IRQ_BASE);
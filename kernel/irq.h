@@ -38,6 +38,25 @@ __END_DECLS;
 void enable_irqs(void);
 void disable_irqs(void);
 
+// disable IRQs and return the previous state for restore_irqs()
+uint32_t save_irqs(void);
+void restore_irqs(uint32_t state);
+
+// disable IRQs on this core for the lifetime of the object
+class Guard {
+public:
+    Guard() : state_(save_irqs()) { }
+
+    ~Guard() {
+	restore_irqs(state_);
+    }
+
+    Guard(const Guard &) = delete;
+    Guard & operator =(const Guard &) = delete;
+private:
+    uint32_t state_;
+};
+
 enum IRQ {
     //IRQ_TIMER0               =  0, // GPU used
     IRQ_TIMER1               =  1,
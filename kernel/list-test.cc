@@ -34,6 +34,10 @@ public:
 	if (&c == this) { }
 	const Foo &c2 = c.prev<All>();
 	if (&c2 == this) { }
+	Foo other;
+	other.link_before<Same>(*this);
+	if (alone<Same>()) { }
+	other.unlink<Same>();
     }
 private:
     Foo(const Foo &&) = delete;
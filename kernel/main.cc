@@ -22,11 +22,14 @@
 #include <sys/cdefs.h>
 #include <stdint.h>
 #include "arch_info.h"
+#include "boottime.h"
 #include "kprintf.h"
+#include "sched.h"
+#include "smp.h"
 #include "timer.h"
 #include "memory/pagetable.h"
-#include "memory/LeafEntry.h"
-#include "memory/TableEntry.h"
+#include "memory/MappingIterator.h"
+#include "memory/slab.h"
 
 #define UNUSED(x) (void)(x)
 
@@ -48,9 +51,18 @@ extern "C" {
     }
 };
 
+// print a few lines, yielding to threads of the same priority in between
+static void demo_thread(void *arg) {
+    const char *name = (const char *)arg;
+    for (int i = 0; i < 3; ++i) {
+	kprintf("%s: turn %d\n", name, i);
+	Sched::yield();
+    }
+}
+
 typedef struct {
     uint32_t *kernel_page_table_phys;
-    uint32_t *kernel_leaf_table_phys;
+    uint32_t *boot_leaf_tables_phys;
 } BootInfo;
 
 // main C function, called from boot.S
@@ -64,50 +76,38 @@ extern "C" EXPORT void kernel_main(uint32_t r0, uint32_t id, const Atag *atag) {
     // print boot info
     BootInfo *boot_info = (BootInfo *)r0;
     kprintf("kernel_page_table_phys = %p\n", boot_info->kernel_page_table_phys);
-    kprintf("kernel_leaf_table_phys = %p\n", boot_info->kernel_leaf_table_phys);
+    kprintf("boot_leaf_tables_phys  = %p\n", boot_info->boot_leaf_tables_phys);
     
     // print page table
-    const char * addr = (char * const)0;
-    for (int i = 0; i < 4096; ++i) {
-	const Memory::TableEntry te = Memory::table_entry(addr);
-	bool printed = false;
-	const char * addr2 = addr;
-	const char *last_addr = addr;
-	Memory::LeafEntry last = Memory::LeafEntry::FAULT();
-	const char *sep = "  ...\n";
-	for (int j = 0; j < 256; ++j) {
-	    const Memory::LeafEntry le = Memory::leaf_entry(addr2);
-	    if (le != Memory::LeafEntry::FAULT()) {
-		if (!printed) {
-		    kprintf("%p = %#10.8lX\n", addr, te.raw());
-		    printed = true;
-		}
-		if (last.raw() + 4096 == le.raw()) {
-		    kprintf("%s", sep);
-		    sep = "";
-		} else {
-		    if ((last != Memory::LeafEntry::FAULT())  && (sep[0] == 0)){
-			kprintf("  %p = %#10.8lX\n", last_addr, last.raw());
-		    }
-		    kprintf("  %p = %#10.8lX\n", addr2, le.raw());
-		    sep = "  ...\n";
-		}
-		last_addr = addr2;
-		last = le;
-	    } else {
-		if ((last != Memory::LeafEntry::FAULT()) && (sep[0] == 0)) {
-		    kprintf("  %p = %#10.8lX\n", last_addr, last.raw());
-		}
-		last = Memory::LeafEntry::FAULT();
+    {
+	BootTime::Stage stage("page table dump");
+	Memory::MappingIterator it;
+	Memory::Extent extent;
+	while (it.next(extent)) {
+	    kprintf("%p - %p = %#10.8lx %s", extent.virt,
+		    extent.virt + (extent.size - 1), extent.phys.x,
+		    Memory::mode_name(extent.mode));
+	    if (extent.mode == Memory::MODE_UNKNOWN) {
+		kprintf(" (%#5.3lx)", extent.attr.raw());
 	    }
-	    addr2 += 4096;
-	}
-	if ((last != Memory::LeafEntry::FAULT())  && (sep[0] == 0)){
-	    kprintf("  %p = %#10.8lX\n", last_addr, last.raw());
+	    kprintf("\n");
 	}
-	addr = addr2;
     }
 
+    // print kernel heap usage
+    {
+	BootTime::Stage stage("slab report");
+	Memory::slab_report();
+    }
+
+    BootTime::report();
+
+    // from here on kernel_main is the idle thread
+    Sched::start();
+    SMP::start_secondaries();
+    Sched::create("ping", demo_thread, (void *)"ping");
+    Sched::create("pong", demo_thread, (void *)"pong");
+
     Timer::test();
 
     kprintf("\nGoodbye\n");
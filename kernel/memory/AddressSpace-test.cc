@@ -0,0 +1,77 @@
+/* Copyright (C) 2015 Goswin von Brederlow <goswin-v-b@web.de>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+// test user address spaces, run once at boot
+
+#include "AddressSpace.h"
+#include "frames.h"
+#include "slab.h"
+#include "../assert.h"
+#include "../init_priorities.h"
+#include "../kprintf.h"
+
+__BEGIN_NAMESPACE(Kernel);
+__BEGIN_NAMESPACE(Memory);
+
+CONSTRUCTOR(ADDRESS_SPACE_TEST) {
+    AddressSpace *space = AddressSpace::create();
+    PhysAddr page = alloc_frame();
+    assert(space != nullptr && page.valid());
+
+    // switch TTBR0 to a user address space and back
+    volatile uint32_t *user = (volatile uint32_t *)0x00400000;
+    assert(space->map_range(page, (const void *)user, PAGE_SIZE,
+			    USER_WRITE));
+    space->activate();
+    *user = 0xC0FFEE;
+    assert(*user == 0xC0FFEE);
+    kprintf("ASID %lu: user page at %p reads %#lx\n", space->asid(), user,
+	    *user);
+
+    // 16M of anonymous memory, only touched pages cost a frame
+    const char *heap = (const char *)0x01000000;
+    assert(space->add_region(heap, 16 * 1024 * 1024, USER_WRITE));
+    uint32_t before = free_pages();
+    uint32_t sum = 0;
+    for (uint32_t off = 0; off < 16 * 1024 * 1024; off += 1024 * 1024) {
+	sum += *(volatile const uint32_t *)(heap + off);
+    }
+    assert(sum == 0);
+    *(volatile uint32_t *)(heap + 4096) = 42;
+    kprintf("demand paging: read 16 pages, wrote 1, used %lu frames\n",
+	    before - free_pages());
+
+    // the clone shares the written page until one side writes again
+    AddressSpace *child = space->clone();
+    assert(child != nullptr);
+    volatile uint32_t *shared = (volatile uint32_t *)(heap + 4096);
+    child->activate();
+    *shared = *shared + 1;
+    uint32_t in_child = *shared;
+    space->activate();
+    assert(in_child == 43 && *shared == 42);
+    kprintf("copy-on-write: child reads %lu, parent %lu\n", in_child,
+	    *shared);
+    destroy(child);
+
+    AddressSpace::deactivate();
+    destroy(space);
+    free_frame(page);
+} CONSTRUCTOR_END
+
+__END_NAMESPACE(Memory);
+__END_NAMESPACE(Kernel);
@@ -0,0 +1,464 @@
+/* Copyright (C) 2015 Goswin von Brederlow <goswin-v-b@web.de>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+/* User address spaces
+ */
+
+#include <string.h>
+#include "AddressSpace.h"
+#include "asm.h"
+#include "frames.h"
+#include "mmu.h"
+#include "tlb.h"
+#include "slab.h"
+#include "LeafEntry.h"
+#include "TableEntry.h"
+#include "MappingIterator.h"
+#include "../assert.h"
+#include "../core.h"
+#include "../init_priorities.h"
+#include "../irq.h"
+#include "../spinlock.h"
+
+__BEGIN_NAMESPACE(Kernel);
+__BEGIN_NAMESPACE(Memory);
+
+enum {
+    USER_TABLE_ENTRIES = USER_SPACE_END >> 20, // 1024 MBs
+    LEAF_TABLE_SIZE = 1024,
+    LEAF_TABLES_PER_FRAME = PAGE_SIZE / LEAF_TABLE_SIZE,
+};
+
+// ASID allocator, protected by asid_lock
+static SpinLock asid_lock;
+static uint32_t asid_generation = 1U << ASID_BITS;
+static uint32_t next_asid = KERNEL_ASID + 1;
+// ASIDs of the current generation kept by spaces active at the rollover
+static uint32_t reserved_asids[(ASID_MASK + 1) / 32];
+
+// set under asid_lock by activate(), so a rollover sees every active space
+static AddressSpace *current_space[Core::MAX_CORES];
+
+// backs all reads of untouched anonymous memory
+static PhysAddr zero_page = PhysAddr::NONE();
+
+static void clear_frame(PhysAddr frame) {
+    memset(phys_to_virt(frame), 0, PAGE_SIZE);
+}
+
+/* start a new generation, asid_lock is held
+ * Spaces running on a core can not change their ASID under it, they move
+ * into the new generation with their ASID and it is reserved.
+ */
+void rollover_asids() {
+    asid_generation += 1U << ASID_BITS;
+    next_asid = KERNEL_ASID + 1;
+    memset(reserved_asids, 0, sizeof(reserved_asids));
+    for (uint32_t core = 0; core < Core::MAX_CORES; ++core) {
+	AddressSpace *space = current_space[core];
+	if (space == nullptr) continue;
+	uint32_t asid = space->asid();
+	reserved_asids[asid / 32] |= 1U << (asid % 32);
+	space->context_ = asid_generation | asid;
+    }
+    // no old ASID may survive in the TLB when they are handed out again
+    TLB::invalidate_all();
+}
+
+// take the next free ASID, starting a new generation when all are used
+static uint32_t new_context() {
+    while (true) {
+	if (next_asid > ASID_MASK) rollover_asids();
+	uint32_t asid = next_asid++;
+	if ((reserved_asids[asid / 32] & (1U << (asid % 32))) == 0) {
+	    return asid_generation | asid;
+	}
+    }
+}
+
+AddressSpace * AddressSpace::create() {
+    PhysAddr table = alloc_frame();
+    if (!table.valid()) return nullptr;
+    clear_frame(table);
+    uint32_t *entry = (uint32_t *)phys_to_virt(table);
+    clean_dcache_range(entry, entry + PAGE_SIZE / sizeof(uint32_t));
+    dsb();
+    void *mem = kmalloc(sizeof(AddressSpace));
+    if (mem == nullptr) {
+	free_frame(table);
+	return nullptr;
+    }
+    return new(mem) AddressSpace(table);
+}
+
+AddressSpace::AddressSpace(PhysAddr table)
+    : table_(table), context_(0), regions_(nullptr) { }
+
+AddressSpace::~AddressSpace() {
+    {
+	IRQ::Guard guard;
+	Locked locked(asid_lock);
+	for (uint32_t core = 0; core < Core::MAX_CORES; ++core) {
+	    assert(current_space[core] != this);
+	}
+    }
+
+    // pages faulted into regions belong to the address space, clones
+    // may still share them
+    MappingIterator it(*this);
+    Extent extent;
+    while (it.next(extent)) {
+	for (size_t off = 0; off < extent.size; off += PAGE_SIZE) {
+	    PhysAddr phys(extent.phys.x + off);
+	    if (phys.x != zero_page.x && find_region(extent.virt + off)) {
+		release_frame(phys);
+	    }
+	}
+    }
+    while (regions_ != nullptr) {
+	Region *region = regions_;
+	regions_ = region->next;
+	Memory::destroy(region);
+    }
+
+    TableEntry *entry = table();
+    // LeafTables come in groups of 4 sharing one frame
+    for (uint32_t mb = 0; mb < USER_TABLE_ENTRIES;
+	 mb += LEAF_TABLES_PER_FRAME) {
+	if (entry[mb].is_table()) {
+	    free_frame(PhysAddr(entry[mb].raw() & ~(PAGE_SIZE - 1)));
+	}
+    }
+    free_frame(table_);
+    if (asid_current()) {
+	TLB::invalidate_asid(asid());
+    }
+}
+
+TableEntry * AddressSpace::table() const {
+    return (TableEntry *)phys_to_virt(table_);
+}
+
+LeafEntry * AddressSpace::leaf_table(const void * const virt) const {
+    const TableEntry &entry = table()[uintptr_t(virt) >> 20];
+    if (!entry.is_table()) return nullptr;
+    PhysAddr phys(entry.raw() & ~(LEAF_TABLE_SIZE - 1));
+    return (LeafEntry *)phys_to_virt(phys);
+}
+
+// give the 4M around virt a frame of 4 empty LeafTables
+bool AddressSpace::alloc_leaf_tables(const void * const virt) {
+    PhysAddr frame = alloc_frame();
+    if (!frame.valid()) return false;
+    clear_frame(frame);
+    uint32_t *leaf = (uint32_t *)phys_to_virt(frame);
+    clean_dcache_range(leaf, leaf + PAGE_SIZE / sizeof(uint32_t));
+    // empty before any Pagetable entry can point there
+    dsb();
+    TableEntry *entry = &table()[(uintptr_t(virt) >> 20)
+				 & ~(LEAF_TABLES_PER_FRAME - 1)];
+    for (uint32_t i = 0; i < LEAF_TABLES_PER_FRAME; ++i) {
+	entry[i] = TableEntry(PhysAddr(frame.x + i * LEAF_TABLE_SIZE));
+    }
+    clean_dcache_range(entry, entry + LEAF_TABLES_PER_FRAME);
+    return true;
+}
+
+bool AddressSpace::asid_current() const {
+    return context_ != 0
+	&& (context_ & ~ASID_MASK) == asid_generation;
+}
+
+/* make changed LeafEntries for [virt, virt + size) visible
+ * TLB entries only need to go when the ASID is of the current generation,
+ * older ones were flushed with the last rollover.
+ */
+void AddressSpace::sync(const char *virt, size_t size) {
+    uintptr_t first = uintptr_t(virt) >> PAGE_SHIFT;
+    uintptr_t last = (uintptr_t(virt) + size - 1) >> PAGE_SHIFT;
+    for (uintptr_t page = first; page <= last; ) {
+	LeafEntry *leaf = leaf_table((const void *)(page << PAGE_SHIFT));
+	uintptr_t end = (page | 0xFF) < last ? (page | 0xFF) : last;
+	if (leaf != nullptr) {
+	    clean_dcache_range(&leaf[page & 0xFF], &leaf[(end & 0xFF) + 1]);
+	}
+	page = end + 1;
+    }
+    dsb();
+    if (!asid_current()) {
+	// walks see the tables, but no TLB holds entries for them
+	isb();
+    } else if (last - first >= TLB::BATCH_PAGES) {
+	TLB::invalidate_asid(asid());
+    } else {
+	TLB::invalidate_range(virt, size, asid());
+    }
+}
+
+bool AddressSpace::map_range(PhysAddr phys, const void * const virt,
+			     size_t size, Mode mode) {
+    assert(uintptr_t(virt) < USER_SPACE_END
+	   && size <= USER_SPACE_END - uintptr_t(virt));
+    const char *v = (const char *)virt;
+    bool res = true;
+    size_t done;
+    for (done = 0; done < size; done += PAGE_SIZE) {
+	LeafEntry *leaf = leaf_table(v + done);
+	if (leaf == nullptr) {
+	    if (!alloc_leaf_tables(v + done)) {
+		res = false;
+		break;
+	    }
+	    leaf = leaf_table(v + done);
+	}
+	LeafEntry &entry = leaf[(uintptr_t(v + done) >> PAGE_SHIFT) & 0xFF];
+	assert(entry == LeafEntry::FAULT());
+	entry = page_entry(PhysAddr(phys.x + done), mode);
+	// Global is the nG bit: user pages must be tagged with the ASID
+	assert(entry.get<LeafEntry::Global>() == 1);
+    }
+    if (done > 0) sync(v, done);
+    return res;
+}
+
+void AddressSpace::unmap_range(const void * const virt, size_t size) {
+    assert(uintptr_t(virt) < USER_SPACE_END
+	   && size <= USER_SPACE_END - uintptr_t(virt));
+    const char *v = (const char *)virt;
+    for (size_t done = 0; done < size; done += PAGE_SIZE) {
+	LeafEntry *leaf = leaf_table(v + done);
+	if (leaf == nullptr) continue;
+	leaf[(uintptr_t(v + done) >> PAGE_SHIFT) & 0xFF] = LeafEntry::FAULT();
+    }
+    if (size > 0) sync(v, size);
+}
+
+const LeafEntry & AddressSpace::leaf_entry(const void * const virt) const {
+    LeafEntry *leaf = leaf_table(virt);
+    if (leaf == nullptr) return LeafEntry::FAULT();
+    return leaf[(uintptr_t(virt) >> PAGE_SHIFT) & 0xFF];
+}
+
+bool AddressSpace::add_region(const void * const virt, size_t size,
+			      Mode mode) {
+    const char *start = (const char *)virt;
+    assert((uintptr_t(start) & (PAGE_SIZE - 1)) == 0
+	   && (size & (PAGE_SIZE - 1)) == 0 && size > 0
+	   && uintptr_t(start) < USER_SPACE_END
+	   && size <= USER_SPACE_END - uintptr_t(start));
+    assert(mode == USER_READ || mode == USER_WRITE);
+    Region **pos = &regions_;
+    while (*pos != nullptr && (*pos)->start + (*pos)->size <= start) {
+	pos = &(*pos)->next;
+    }
+    if (*pos != nullptr && (*pos)->start < start + size) {
+	return false;
+    }
+    Region *region = Memory::create<Region>();
+    if (region == nullptr) return false;
+    region->start = start;
+    region->size = size;
+    region->mode = mode;
+    region->next = *pos;
+    *pos = region;
+    return true;
+}
+
+const Region * AddressSpace::find_region(const void * const virt) const {
+    const char *v = (const char *)virt;
+    for (const Region *region = regions_;
+	 region != nullptr && region->start <= v; region = region->next) {
+	if (v < region->start + region->size) return region;
+    }
+    return nullptr;
+}
+
+/* map a private writable copy of the page from at page
+ * Replaces the current mapping, a shared page loses one reference.
+ */
+bool AddressSpace::map_private_copy(const char *page, PhysAddr from) {
+    PhysAddr frame = alloc_frame();
+    if (!frame.valid()) return false;
+    if (from.x == zero_page.x) {
+	clear_frame(frame);
+    } else {
+	memcpy(phys_to_virt(frame), phys_to_virt(from), PAGE_SIZE);
+    }
+    bool mapped = leaf_entry(page) != LeafEntry::FAULT();
+    if (mapped) {
+	unmap_range(page, PAGE_SIZE);
+    }
+    if (!map_range(frame, page, PAGE_SIZE, USER_WRITE)) {
+	free_frame(frame);
+	return false;
+    }
+    if (mapped && from.x != zero_page.x) {
+	release_frame(from);
+    }
+    return true;
+}
+
+bool AddressSpace::handle_fault(const void * const virt, bool write) {
+    const Region *region = find_region(virt);
+    if (region == nullptr) return false;
+    const char *page = (const char *)(uintptr_t(virt) & ~(PAGE_SIZE - 1));
+    bool writable = region->mode == USER_WRITE;
+    const LeafEntry &entry = leaf_entry(page);
+    if (entry == LeafEntry::FAULT()) {
+	if (write) {
+	    return writable && map_private_copy(page, zero_page);
+	}
+	return map_range(zero_page, page, PAGE_SIZE, USER_READ);
+    }
+    if (!write || page_mode(entry) == USER_WRITE) {
+	// already resolved, the TLB had a stale entry
+	return true;
+    }
+    if (!writable) return false;
+    PhysAddr phys(entry.raw() & LeafEntry::Addr::MASK);
+    if (phys.x != zero_page.x && frame_shares(phys) == 0) {
+	// copy-on-write page nobody else maps anymore
+	unmap_range(page, PAGE_SIZE);
+	return map_range(phys, page, PAGE_SIZE, USER_WRITE);
+    }
+    return map_private_copy(page, phys);
+}
+
+AddressSpace * AddressSpace::clone() {
+    AddressSpace *child = create();
+    if (child == nullptr) return nullptr;
+    Region **tail = &child->regions_;
+    for (const Region *region = regions_; region != nullptr;
+	 region = region->next) {
+	Region *copy = Memory::create<Region>();
+	if (copy == nullptr) {
+	    Memory::destroy(child);
+	    return nullptr;
+	}
+	*copy = *region;
+	copy->next = nullptr;
+	*tail = copy;
+	tail = &copy->next;
+    }
+
+    // the windows belong to this core, stay on it while they are used
+    IRQ::Guard guard;
+    uint32_t core = Core::id();
+    TableEntry *other_table = (TableEntry *)Core::other_pagetable(core);
+    char *other_leaves = (char *)Core::other_leaftables(core);
+    Memory::map(child->table_, other_table, KERNEL_WRITE);
+
+    TableEntry *entry = table();
+    uintptr_t first = USER_SPACE_END; // range of pages made read-only
+    uintptr_t last = 0;
+    bool complete = true;
+    for (uint32_t mb = 0; mb < USER_TABLE_ENTRIES;
+	 mb += LEAF_TABLES_PER_FRAME) {
+	if (!entry[mb].is_table()) continue;
+	PhysAddr frame = alloc_frame();
+	if (!frame.valid()) {
+	    complete = false;
+	    break;
+	}
+	LeafEntry *dst = (LeafEntry *)(other_leaves + mb * LEAF_TABLE_SIZE);
+	Memory::map(frame, dst, KERNEL_WRITE);
+	for (uint32_t i = 0; i < LEAF_TABLES_PER_FRAME; ++i) {
+	    other_table[mb + i] =
+		TableEntry(PhysAddr(frame.x + i * LEAF_TABLE_SIZE));
+	}
+
+	// the 4 LeafTables of the group are one frame on both sides
+	LeafEntry *src = leaf_table((const void *)(mb << 20));
+	for (uint32_t n = 0; n < PAGE_SIZE / sizeof(LeafEntry); ++n) {
+	    LeafEntry leaf = src[n];
+	    uintptr_t virt = (mb << 20) + (n << PAGE_SHIFT);
+	    PhysAddr phys(leaf.raw() & LeafEntry::Addr::MASK);
+	    if (leaf != LeafEntry::FAULT() && phys.x != zero_page.x
+		&& find_region((const void *)virt)) {
+		// pages owned by the address space become copy-on-write
+		if (page_mode(leaf) == USER_WRITE) {
+		    leaf = page_entry(phys, USER_READ);
+		    src[n] = leaf;
+		    if (virt < first) first = virt;
+		    last = virt;
+		}
+		share_frame(phys);
+	    }
+	    dst[n] = leaf;
+	}
+	clean_dcache_range(dst, dst + PAGE_SIZE / sizeof(LeafEntry));
+    }
+    clean_dcache_range(other_table, other_table + USER_TABLE_ENTRIES);
+    dsb();
+    Memory::unmap_range(other_leaves, SECTION_SIZE);
+    Memory::unmap_range(other_table, PAGE_SIZE);
+
+    // the parent must not write through stale writable TLB entries
+    if (first <= last) {
+	sync((const char *)first, last - first + PAGE_SIZE);
+    }
+    if (!complete) {
+	Memory::destroy(child);
+	return nullptr;
+    }
+    return child;
+}
+
+AddressSpace * AddressSpace::current() {
+    return current_space[Core::id()];
+}
+
+void AddressSpace::activate() {
+    IRQ::Guard guard;
+    {
+	Locked locked(asid_lock);
+	if (!asid_current()) {
+	    context_ = new_context();
+	}
+	current_space[Core::id()] = this;
+    }
+    /* Go through the reserved ASID so no walk can combine the new table
+     * with the old ASID or the old table with the new ASID.
+     */
+    set_context_id(KERNEL_ASID);
+    isb();
+    set_ttbr0(table_);
+    isb();
+    set_context_id(asid());
+    isb();
+}
+
+void AddressSpace::deactivate() {
+    uint32_t ttbr1;
+    asm volatile ("mrc p15, 0, %0, c2, c0, 1" : "=r"(ttbr1));
+    IRQ::Guard guard;
+    set_context_id(KERNEL_ASID);
+    isb();
+    asm volatile ("mcr p15, 0, %0, c2, c0, 0" : : "r"(ttbr1) : "memory");
+    isb();
+    Locked locked(asid_lock);
+    current_space[Core::id()] = nullptr;
+}
+
+CONSTRUCTOR(ZERO_PAGE) {
+    zero_page = alloc_frame();
+    assert(zero_page.valid());
+    clear_frame(zero_page);
+} CONSTRUCTOR_END
+
+__END_NAMESPACE(Memory);
+__END_NAMESPACE(Kernel);
@@ -0,0 +1,154 @@
+/* Copyright (C) 2015 Goswin von Brederlow <goswin-v-b@web.de>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+/* User address spaces
+ *
+ * With TTBCR.N = 2 the MMU translates 0 - 1G through TTBR0 and everything
+ * above through TTBR1. The kernel Pagetable stays on TTBR1 and is shared by
+ * everyone, every AddressSpace has its own 4k Pagetable for TTBR0. User
+ * mappings are not global and tagged with the ASID of their AddressSpace,
+ * so switching address spaces needs no TLB flush.
+ *
+ * ASIDs are handed out on activate(). Each one carries the generation it
+ * was allocated in. When all 255 ASIDs are used up the generation is
+ * bumped and the TLB flushed once; address spaces still holding an ASID of
+ * an old generation get a new one the next time they are activated. The
+ * spaces active on some core keep their ASID into the new generation and
+ * it is not handed out again. ASID 0 is reserved for the kernel and used
+ * while switching.
+ *
+ * Regions describe anonymous memory that is mapped on demand by the data
+ * abort handler. A read of an untouched page maps the shared zero page
+ * read-only, a write maps a freshly zeroed page. Those pages belong to the
+ * AddressSpace and are freed with it.
+ *
+ * clone() fills the tables of the copy through the COREn_OTHER_PAGETABLE
+ * and COREn_OTHER_LEAFTABLES windows of the current core. Shared pages are
+ * counted in their PageInfo.
+ */
+
+#ifndef KERNEL_MEMORY_ADDRESSSPACE_H
+#define KERNEL_MEMORY_ADDRESSSPACE_H 1
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/cdefs.h>
+#include "fixed_addresses.h"
+#include "PhysAddr.h"
+#include "pagetable.h"
+
+__BEGIN_NAMESPACE(Kernel);
+__BEGIN_NAMESPACE(Memory);
+
+enum {
+    ASID_BITS = 8,
+    ASID_MASK = (1U << ASID_BITS) - 1,
+    KERNEL_ASID = 0,
+};
+
+// anonymous memory mapped on demand, sorted list per AddressSpace
+struct Region {
+    const char *start;
+    size_t size;
+    Mode mode;     // USER_READ or USER_WRITE
+    Region *next;
+};
+
+class AddressSpace {
+public:
+    /* allocate an empty address space
+     * Returns nullptr when out of memory.
+     */
+    static AddressSpace * create();
+
+    /* free the Pagetable and all LeafTables, not the mapped pages
+     * The address space must not be active on any core.
+     */
+    ~AddressSpace();
+
+    /* map size bytes of user memory with 4k pages
+     * Returns false when no LeafTable could be allocated, pages mapped so
+     * far stay mapped.
+     */
+    bool map_range(PhysAddr phys, const void * const virt, size_t size,
+		   Mode mode);
+
+    void unmap_range(const void * const virt, size_t size);
+
+    // entry for virt, LeafEntry::FAULT() when not mapped
+    const LeafEntry & leaf_entry(const void * const virt) const;
+
+    /* reserve size bytes at virt for anonymous memory, nothing is mapped
+     * Returns false when the range overlaps another region or no memory
+     * is left for the descriptor.
+     */
+    bool add_region(const void * const virt, size_t size, Mode mode);
+
+    // region containing virt, nullptr when there is none
+    const Region * find_region(const void * const virt) const;
+
+    /* resolve a translation or permission fault at virt from a region
+     * Returns false when the access is not allowed or out of memory.
+     */
+    bool handle_fault(const void * const virt, bool write);
+
+    /* copy the address space, e.g. for a new task
+     * Pages of regions are shared copy-on-write: both sides map them
+     * read-only and the first write fault copies the page. All other
+     * mappings are shared as they are. Returns nullptr when out of
+     * memory.
+     */
+    AddressSpace * clone();
+
+    // address space active on this core, nullptr while none is
+    static AddressSpace * current();
+
+    // switch TTBR0 and CONTEXTIDR to this address space
+    void activate();
+
+    // switch back to the kernel Pagetable on TTBR0
+    static void deactivate();
+
+    // ASID from the last activate(), may be from an old generation
+    uint32_t asid() const {
+	return context_ & ASID_MASK;
+    }
+
+    AddressSpace(const AddressSpace &) = delete;
+    AddressSpace & operator =(const AddressSpace &) = delete;
+private:
+    friend class MappingIterator;
+    friend void rollover_asids();
+
+    explicit AddressSpace(PhysAddr table);
+
+    TableEntry * table() const;
+    LeafEntry * leaf_table(const void * const virt) const;
+    bool alloc_leaf_tables(const void * const virt);
+    bool asid_current() const;
+    void sync(const char *virt, size_t size);
+    bool map_private_copy(const char *page, PhysAddr from);
+
+    PhysAddr table_;   // 4k Pagetable for TTBR0
+    uint32_t context_; // generation | ASID, 0 when never activated
+    Region *regions_;
+};
+
+__END_NAMESPACE(Memory);
+__END_NAMESPACE(Kernel);
+
+#endif // #ifndef KERNEL_MEMORY_ADDRESSSPACE_H
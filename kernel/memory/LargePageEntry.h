@@ -0,0 +1,102 @@
+/* Copyright (C) 2015 Goswin von Brederlow <goswin-v-b@web.de>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+/* Second level Pagetable large page entry bitfield
+ */
+
+#ifndef KERNEL_MEMORY_LARGEPAGEENTRY_H
+#define KERNEL_MEMORY_LARGEPAGEENTRY_H 1
+
+#include <sys/cdefs.h>
+#include <Bitfield.h>
+#include "PhysAddr.h"
+
+__BEGIN_NAMESPACE(Kernel);
+__BEGIN_NAMESPACE(Memory);
+
+/* Bitfield for 64k large page entries in LeafTables
+ * A large page must be repeated in 16 consecutive LeafTable entries.
+ */
+class LargePageEntry : public Bitfield<LargePageEntry> {
+public:
+    /*
+    struct {
+	uint32_t addr       : 16;
+	uint32_t not_exec   : 1;
+	uint32_t tex        : 3;
+	uint32_t not_global : 1;
+	uint32_t shared     : 1;
+	uint32_t ap2        : 1;
+	uint32_t SBZ        : 3;
+	uint32_t ap         : 2;
+	uint32_t cached     : 1;
+	uint32_t buffered   : 1;
+	uint32_t ZERO       : 1; // Large page
+	uint32_t ONE        : 1; // Large page
+    };
+    */
+    using Addr      = Bits<31, 16>;
+    using Exec      = Bit<15>;
+    using Tex       = Bits<14, 12>;
+    using Global    = Bit<11>;
+    using Shared    = Bit<10>;
+    using Ap        = Field<Bit<9>, Bits<5, 4> >;
+    using Cached    = Bit<3>;
+    using Buffered  = Bit<2>;
+
+    static constexpr const Global GLOBAL{false};
+    static constexpr const Shared SHARED{true};
+    static constexpr const Cached CACHED{true};
+    static constexpr const Buffered BUFFERED{true};
+    static constexpr const Exec EXEC{false};
+
+    explicit constexpr LargePageEntry() : Bitfield(RAW, 0) { }
+
+    explicit constexpr LargePageEntry(Raw r, uint32_t x) : Bitfield(r, x) { }
+
+    template<typename ... Ts>
+    constexpr LargePageEntry(PhysAddr phys, const Ts ... ts)
+        : Bitfield(Addr(phys.x >> 16), ts ...) { }
+
+    static constexpr M FIXED() {
+	return M(SBZ, LARGE_PAGE);
+    };
+
+    static constexpr M DEFAULT() {
+	return M(!GLOBAL, !EXEC);
+    };
+
+    static const LargePageEntry FAULT() { return LargePageEntry(); }
+
+    bool operator == (const LargePageEntry other) const {
+	return raw() == other.raw();
+    }
+
+    bool operator != (const LargePageEntry other) const {
+	return raw() != other.raw();
+    }
+private:
+    using Sbz       = Bits<8, 6>;
+    using Type      = Bits<1, 0>;
+    static constexpr const Sbz SBZ{0};
+    static constexpr const Type LARGE_PAGE{0b01};
+};
+
+__END_NAMESPACE(Memory);
+__END_NAMESPACE(Kernel);
+
+#endif // #ifndef KERNEL_MEMORY_LARGEPAGEENTRY_H
@@ -62,6 +62,8 @@ public:
 
     explicit constexpr LeafEntry() : Bitfield(RAW, 0) { }
 
+    explicit constexpr LeafEntry(Raw r, uint32_t x) : Bitfield(r, x) { }
+
     template<typename ... Ts>
     constexpr LeafEntry(PhysAddr phys, const Ts ... ts)
         : Bitfield(Addr(phys.x >> 12), ts ...) { }
@@ -79,6 +81,16 @@ public:
 	return entry;
     }
 
+    // entry maps a 4k small page
+    constexpr bool is_small() const {
+	return is(SMALL_PAGE);
+    }
+
+    // entry is really part of a LargePageEntry
+    constexpr bool is_large() const {
+	return (raw() & 0b11) == 0b01;
+    }
+
     bool operator == (const LeafEntry other) const {
 	return raw() == other.raw();
     }
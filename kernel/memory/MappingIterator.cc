@@ -0,0 +1,133 @@
+/* Copyright (C) 2015 Goswin von Brederlow <goswin-v-b@web.de>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+/* Iterate over the mappings of a page table
+ */
+
+#include "MappingIterator.h"
+#include "AddressSpace.h"
+#include "frames.h"
+#include "fixed_addresses.h"
+#include "TableEntry.h"
+#include "SectionEntry.h"
+#include "LargePageEntry.h"
+
+__BEGIN_NAMESPACE(Kernel);
+__BEGIN_NAMESPACE(Memory);
+
+enum {
+    PAGES_PER_SECTION = SECTION_SIZE / PAGE_SIZE,
+    PAGES_PER_LARGE_PAGE = LARGE_PAGE_SIZE / PAGE_SIZE,
+};
+
+// the attributes of a section or large page as small page entry
+template<typename Entry>
+static LeafEntry small_page(const Entry entry) {
+    return LeafEntry(PhysAddr(0),
+		     LeafEntry::Ap(entry.template get<typename Entry::Ap>()),
+		     LeafEntry::Tex(entry.template get<typename Entry::Tex>()),
+		     LeafEntry::Cached(entry.template get<typename Entry::Cached>()),
+		     LeafEntry::Buffered(
+			 entry.template get<typename Entry::Buffered>()),
+		     LeafEntry::Shared(entry.template get<typename Entry::Shared>()),
+		     LeafEntry::Global(entry.template get<typename Entry::Global>()),
+		     LeafEntry::Exec(entry.template get<typename Entry::Exec>()));
+}
+
+MappingIterator::MappingIterator()
+    : table_((const TableEntry *)KERNEL_PAGETABLE),
+      pages_(4096 * PAGES_PER_SECTION), user_(false), pos_(0) {
+}
+
+MappingIterator::MappingIterator(const AddressSpace &space)
+    : table_(space.table()), pages_(USER_SPACE_END >> PAGE_SHIFT),
+      user_(true), pos_(0) {
+}
+
+const LeafEntry * MappingIterator::leaf_table(uint32_t mb) const {
+    if (user_) {
+	PhysAddr phys(table_[mb].raw() & TableEntry::Addr::MASK);
+	return (const LeafEntry *)phys_to_virt(phys);
+    }
+    return (const LeafEntry *)(KERNEL_LEAFTABLES + mb * 1024);
+}
+
+/* describe the entry at pos_ in piece, size is 0 when it maps nothing
+ * Returns the number of pages the entry covers from pos_ on.
+ */
+uint32_t MappingIterator::decode(Extent &piece) const {
+    uint32_t mb = pos_ / PAGES_PER_SECTION;
+    uint32_t index = pos_ % PAGES_PER_SECTION;
+    const TableEntry &table = table_[mb];
+    uint32_t pages;
+    piece.virt = (const char *)(pos_ << PAGE_SHIFT);
+    piece.size = 0;
+    if (table.is_section()) {
+	SectionEntry section(RAW, table.raw());
+	pages = PAGES_PER_SECTION - index;
+	piece.phys = PhysAddr((section.raw() & SectionEntry::Addr::MASK)
+			      + (index << PAGE_SHIFT));
+	piece.attr = small_page(section);
+    } else if (table.is_table()) {
+	const LeafEntry entry = leaf_table(mb)[index];
+	if (entry.is_small()) {
+	    pages = 1;
+	    piece.phys = PhysAddr(entry.raw() & LeafEntry::Addr::MASK);
+	    piece.attr = LeafEntry(RAW, entry.raw() & ~LeafEntry::Addr::MASK);
+	} else if (entry.is_large()) {
+	    LargePageEntry large(RAW, entry.raw());
+	    uint32_t offset = index % PAGES_PER_LARGE_PAGE;
+	    pages = PAGES_PER_LARGE_PAGE - offset;
+	    piece.phys = PhysAddr((large.raw() & LargePageEntry::Addr::MASK)
+				  + (offset << PAGE_SHIFT));
+	    piece.attr = small_page(large);
+	} else {
+	    return 1;
+	}
+    } else {
+	// nothing mapped in this MB
+	return PAGES_PER_SECTION - index;
+    }
+    piece.size = pages << PAGE_SHIFT;
+    return pages;
+}
+
+bool MappingIterator::next(Extent &extent) {
+    extent.size = 0;
+    while (pos_ < pages_) {
+	Extent piece;
+	uint32_t pages = decode(piece);
+	if (piece.size == 0) {
+	    if (extent.size != 0) break;
+	} else if (extent.size == 0) {
+	    extent = piece;
+	} else if (piece.virt == extent.virt + extent.size
+		   && piece.phys.x == extent.phys.x + extent.size
+		   && piece.attr == extent.attr) {
+	    extent.size += piece.size;
+	} else {
+	    break;
+	}
+	pos_ += pages;
+    }
+    if (extent.size == 0) return false;
+    extent.mode = page_mode(extent.attr);
+    return true;
+}
+
+__END_NAMESPACE(Memory);
+__END_NAMESPACE(Kernel);
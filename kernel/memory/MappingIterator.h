@@ -0,0 +1,80 @@
+/* Copyright (C) 2015 Goswin von Brederlow <goswin-v-b@web.de>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+/* Iterate over the mappings of a page table
+ *
+ * Walks the Pagetable of the kernel or of an AddressSpace and returns the
+ * mappings as extents of virtually and physically contiguous memory with
+ * the same attributes. Unused MBs are skipped with a single look at their
+ * Pagetable entry, sections and large pages are taken as a whole.
+ *
+ *     MappingIterator it;
+ *     Extent extent;
+ *     while (it.next(extent)) { ... }
+ */
+
+#ifndef KERNEL_MEMORY_MAPPINGITERATOR_H
+#define KERNEL_MEMORY_MAPPINGITERATOR_H 1
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/cdefs.h>
+#include "PhysAddr.h"
+#include "LeafEntry.h"
+#include "pagetable.h"
+
+__BEGIN_NAMESPACE(Kernel);
+__BEGIN_NAMESPACE(Memory);
+
+class TableEntry;
+class AddressSpace;
+
+struct Extent {
+    Extent() : virt(nullptr), phys(0), size(0), mode(MODE_UNKNOWN), attr() { }
+
+    const char *virt;
+    PhysAddr phys;
+    size_t size;
+    Mode mode;
+    // attributes as a small page entry, sections and large pages converted
+    LeafEntry attr;
+};
+
+class MappingIterator {
+public:
+    // mappings in the kernel Pagetable, including the identity mappings
+    MappingIterator();
+
+    // mappings of a user address space
+    explicit MappingIterator(const AddressSpace &space);
+
+    // get the next extent, returns false when there are no more
+    bool next(Extent &extent);
+private:
+    const LeafEntry * leaf_table(uint32_t mb) const;
+    uint32_t decode(Extent &piece) const;
+
+    const TableEntry *table_;
+    uint32_t pages_;   // number of pages covered by table_
+    bool user_;        // LeafTables are reached through the linear mapping
+    uint32_t pos_;     // page number of the next entry to look at
+};
+
+__END_NAMESPACE(Memory);
+__END_NAMESPACE(Kernel);
+
+#endif // #ifndef KERNEL_MEMORY_MAPPINGITERATOR_H
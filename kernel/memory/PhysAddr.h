@@ -29,6 +29,11 @@ __BEGIN_NAMESPACE(Memory);
 
 struct PhysAddr {
     explicit constexpr PhysAddr(uint32_t phys) : x(phys) { }
+
+    // returned by allocators when no memory is available
+    static constexpr PhysAddr NONE() { return PhysAddr(~0U); }
+
+    constexpr bool valid() const { return x != ~0U; }
     
     uint32_t x;
 };
@@ -0,0 +1,37 @@
+/* Copyright (C) 2015 Goswin von Brederlow <goswin-v-b@web.de>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+/* First level Pagetable section entry bitfield
+ */
+
+#include "pagetable.h"
+#include "SectionEntry.h"
+
+__BEGIN_NAMESPACE(Kernel);
+__BEGIN_NAMESPACE(Memory);
+
+constexpr const SectionEntry::Global SectionEntry::GLOBAL;
+constexpr const SectionEntry::Shared SectionEntry::SHARED;
+constexpr const SectionEntry::Cached SectionEntry::CACHED;
+constexpr const SectionEntry::Buffered SectionEntry::BUFFERED;
+constexpr const SectionEntry::Exec SectionEntry::EXEC;
+constexpr const SectionEntry::Super SectionEntry::SUPER;
+constexpr const SectionEntry::Ecc SectionEntry::ECC;
+constexpr const SectionEntry::Type SectionEntry::SECTION;
+
+__END_NAMESPACE(Memory);
+__END_NAMESPACE(Kernel);
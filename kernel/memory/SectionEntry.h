@@ -0,0 +1,106 @@
+/* Copyright (C) 2015 Goswin von Brederlow <goswin-v-b@web.de>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+/* First level Pagetable section entry bitfield
+ */
+
+#ifndef KERNEL_MEMORY_SECTIONENTRY_H
+#define KERNEL_MEMORY_SECTIONENTRY_H 1
+
+#include <sys/cdefs.h>
+#include <Bitfield.h>
+#include "PhysAddr.h"
+
+__BEGIN_NAMESPACE(Kernel);
+__BEGIN_NAMESPACE(Memory);
+
+// Bitfield for 1M section entries in the Pagetable
+class SectionEntry : public Bitfield<SectionEntry> {
+public:
+    /*
+    struct {
+	uint32_t addr       : 12;
+	uint32_t not_secure : 1;
+	uint32_t ZERO       : 1; // Section
+	uint32_t not_global : 1;
+	uint32_t shared     : 1;
+	uint32_t ap2        : 1;
+	uint32_t tex        : 3;
+	uint32_t ap         : 2;
+	uint32_t ecc        : 1;
+	uint32_t domain     : 4;
+	uint32_t not_exec   : 1;
+	uint32_t cached     : 1;
+	uint32_t buffered   : 1;
+	uint32_t ONE        : 1; // Section
+	uint32_t ZERO       : 1; // Section
+    };
+    */
+    using Addr      = Bits<31, 20>;
+    using Global    = Bit<17>;
+    using Shared    = Bit<16>;
+    using Ap        = Field<Bit<15>, Bits<11, 10> >;
+    using Tex       = Bits<14, 12>;
+    using Exec      = Bit<4>;
+    using Cached    = Bit<3>;
+    using Buffered  = Bit<2>;
+
+    static constexpr const Global GLOBAL{false};
+    static constexpr const Shared SHARED{true};
+    static constexpr const Cached CACHED{true};
+    static constexpr const Buffered BUFFERED{true};
+    static constexpr const Exec EXEC{false};
+
+    explicit constexpr SectionEntry() : Bitfield(RAW, 0) { }
+
+    explicit constexpr SectionEntry(Raw r, uint32_t x) : Bitfield(r, x) { }
+
+    template<typename ... Ts>
+    constexpr SectionEntry(PhysAddr phys, const Ts ... ts)
+        : Bitfield(Addr(phys.x >> 20), ts ...) { }
+
+    static constexpr M FIXED() {
+	return M(!SUPER, !ECC, SECTION);
+    };
+
+    static constexpr M DEFAULT() {
+	return M(!GLOBAL, !EXEC, Domain(0));
+    };
+
+    static const SectionEntry FAULT() { return SectionEntry(); }
+
+    bool operator == (const SectionEntry other) const {
+	return raw() == other.raw();
+    }
+
+    bool operator != (const SectionEntry other) const {
+	return raw() != other.raw();
+    }
+private:
+    using Super     = Bit<18>;
+    using Ecc       = Bit<9>;
+    using Domain    = Bits<8, 5>;
+    using Type      = Bits<1, 0>;
+    static constexpr const Super SUPER{true};
+    static constexpr const Ecc ECC{true};
+    static constexpr const Type SECTION{0b10};
+};
+
+__END_NAMESPACE(Memory);
+__END_NAMESPACE(Kernel);
+
+#endif // #ifndef KERNEL_MEMORY_SECTIONENTRY_H
@@ -28,5 +28,9 @@ constexpr const TableEntry::Ecc TableEntry::ECC;
 constexpr const TableEntry::Sbz TableEntry::SBZ;
 constexpr const TableEntry::Coarse TableEntry::COARSE;
 
+// must match the coarse table entries boot.S writes: address | 1
+static_assert(TableEntry(PhysAddr(0x12345400)).raw() == (0x12345400 | 1),
+	      "TableEntry(PhysAddr) sets bits other than Coarse");
+
 __END_NAMESPACE(Memory);
 __END_NAMESPACE(Kernel);
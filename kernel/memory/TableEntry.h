@@ -47,9 +47,11 @@ public:
 
     explicit constexpr TableEntry() : Bitfield(RAW, 0) { }
 
+    explicit constexpr TableEntry(Raw r, uint32_t x) : Bitfield(r, x) { }
+
     template<typename ... Ts>
     constexpr TableEntry(PhysAddr phys, const Ts ... ts)
-        : Bitfield(Addr(phys.x >> 12), ts ...) { }
+        : Bitfield(Addr(phys.x >> 10), ts ...) { }
 
     static constexpr M FIXED() {
 	return M(!ECC, SBZ, COARSE);
@@ -61,6 +63,16 @@ public:
 
     static const TableEntry FAULT() { return TableEntry(); }
 
+    // entry points to a LeafTable
+    constexpr bool is_table() const {
+	return get<Coarse>() == 0b01;
+    }
+
+    // entry is really a SectionEntry
+    constexpr bool is_section() const {
+	return get<Coarse>() == 0b10;
+    }
+
     bool operator == (const TableEntry other) const {
 	return raw() == other.raw();
     }
@@ -74,7 +86,7 @@ private:
     using Sbz       = Field<Bit<4>, Bit<2> >;
     using Coarse    = Bits<1, 0>;
     static constexpr const Ecc ECC{true};
-    static constexpr const Sbz SBZ{0b11};
+    static constexpr const Sbz SBZ{0};
     static constexpr const Coarse COARSE{0b01};
 };
 
@@ -0,0 +1,244 @@
+/* Copyright (C) 2015 Goswin von Brederlow <goswin-v-b@web.de>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+/* Data and instruction cache maintenance
+ */
+
+#include "cache.h"
+#include "asm.h"
+#include "../init_priorities.h"
+#include "../kprintf.h"
+
+__BEGIN_NAMESPACE(Kernel);
+__BEGIN_NAMESPACE(Cache);
+
+enum {
+    CTR_FORMAT_ARMV7 = 0b100,
+    MAX_LEVELS = 7,
+};
+
+// geometry of one data or unified cache level for set/way operations
+struct Level {
+    uint32_t line_shift; // log2 of the line size in bytes
+    uint32_t way_shift;  // way number goes into the top bits
+    uint32_t ways;
+    uint32_t sets;
+};
+
+static bool armv7;
+static uint32_t dline = 32;
+static uint32_t iline = 32;
+static uint32_t num_levels; // data or unified levels up to LoC
+static Level level[MAX_LEVELS];
+
+static uint32_t read_ctr() {
+    uint32_t t;
+    asm volatile ("mrc p15, 0, %0, c0, c0, 1" : "=r"(t));
+    return t;
+}
+
+static uint32_t read_clidr() {
+    uint32_t t;
+    asm volatile ("mrc p15, 1, %0, c0, c0, 1" : "=r"(t));
+    return t;
+}
+
+// CCSIDR of the data or unified cache of level n (0 based)
+static uint32_t read_ccsidr(uint32_t n) {
+    uint32_t t;
+    asm volatile ("mcr p15, 2, %0, c0, c0, 0" : : "r"(n << 1));
+    isb();
+    asm volatile ("mrc p15, 1, %0, c0, c0, 0" : "=r"(t));
+    return t;
+}
+
+static uint32_t log2_ceil(uint32_t x) {
+    return (x <= 1) ? 0 : 32 - __builtin_clz(x - 1);
+}
+
+CONSTRUCTOR(CACHE) {
+    uint32_t ctr = read_ctr();
+    armv7 = (ctr >> 29) == CTR_FORMAT_ARMV7;
+    if (armv7) {
+	// DminLine and IminLine are log2 of the number of words
+	dline = 4U << ((ctr >> 16) & 0xF);
+	iline = 4U << (ctr & 0xF);
+	uint32_t clidr = read_clidr();
+	uint32_t loc = (clidr >> 24) & 0x7;
+	for (uint32_t n = 0; n < loc && n < MAX_LEVELS; ++n) {
+	    uint32_t type = (clidr >> (3 * n)) & 0x7;
+	    if (type < 2) continue; // no data or unified cache
+	    uint32_t ccsidr = read_ccsidr(n);
+	    Level &l = level[num_levels++];
+	    l.line_shift = (ccsidr & 0x7) + 4;
+	    l.ways = ((ccsidr >> 3) & 0x3FF) + 1;
+	    l.sets = ((ccsidr >> 13) & 0x7FFF) + 1;
+	    // the way goes into the top bits, a direct mapped cache has none
+	    l.way_shift = (l.ways == 1) ? 0 : 32 - log2_ceil(l.ways);
+	}
+    } else {
+	// ARMv6: len field of Dsize and Isize, 8 << len bytes
+	dline = 8U << ((ctr >> 12) & 0x3);
+	iline = 8U << (ctr & 0x3);
+    }
+    kprintf("Caches      : D line %lu, I line %lu, %lu levels to LoC\n",
+	    dline, iline, num_levels);
+} CONSTRUCTOR_END
+
+uint32_t dcache_line() {
+    return dline;
+}
+
+uint32_t icache_line() {
+    return iline;
+}
+
+static inline void dccmvac(uintptr_t mva) {
+    asm volatile ("mcr p15, 0, %0, c7, c10, 1" : : "r"(mva) : "memory");
+}
+
+static inline void dcimvac(uintptr_t mva) {
+    asm volatile ("mcr p15, 0, %0, c7, c6, 1" : : "r"(mva) : "memory");
+}
+
+static inline void dccimvac(uintptr_t mva) {
+    asm volatile ("mcr p15, 0, %0, c7, c14, 1" : : "r"(mva) : "memory");
+}
+
+static inline void icimvau(uintptr_t mva) {
+    asm volatile ("mcr p15, 0, %0, c7, c5, 1" : : "r"(mva) : "memory");
+}
+
+// run op on every line overlapping [start, start + size)
+template<void (*op)(uintptr_t)>
+static void for_lines(uintptr_t start, size_t size, uint32_t line) {
+    if (size == 0) return;
+    uintptr_t end = start + size;
+    for (uintptr_t p = start & ~uintptr_t(line - 1); p < end; p += line) {
+	op(p);
+    }
+}
+
+void clean_range(const void *start, size_t size) {
+    dsb();
+    clean_lines(start, size);
+    dsb();
+}
+
+void clean_lines(const void *start, size_t size) {
+    for_lines<dccmvac>(uintptr_t(start), size, dline);
+}
+
+void invalidate_range(const void *start, size_t size) {
+    if (size == 0) return;
+    uintptr_t first = uintptr_t(start);
+    uintptr_t end = first + size;
+    uintptr_t mask = dline - 1;
+    dsb();
+    // partial lines at the edges hold data of others
+    if ((first & mask) != 0) {
+	dccimvac(first & ~mask);
+	first = (first | mask) + 1;
+    }
+    if ((end & mask) != 0 && end > first) {
+	end &= ~mask;
+	dccimvac(end);
+    }
+    if (end > first) {
+	for_lines<dcimvac>(first, end - first, dline);
+    }
+    dsb();
+}
+
+void clean_invalidate_range(const void *start, size_t size) {
+    dsb();
+    for_lines<dccimvac>(uintptr_t(start), size, dline);
+    dsb();
+}
+
+void sync_icache_range(const void *start, size_t size) {
+    clean_range(start, size);
+    for_lines<icimvau>(uintptr_t(start), size, iline);
+    // BPIALL, branch predictors may hold the old code
+    asm volatile ("mcr p15, 0, %0, c7, c5, 6" : : "r"(0) : "memory");
+    dsb();
+    isb();
+}
+
+// CRm of the set/way and entire cache forms: c10 clean, c6 invalidate,
+// c14 clean and invalidate
+enum Op { CLEAN, INVALIDATE, CLEAN_INVALIDATE };
+
+static inline void set_way(Op op, uint32_t x) {
+    switch (op) {
+    case CLEAN:
+	asm volatile ("mcr p15, 0, %0, c7, c10, 2" : : "r"(x) : "memory");
+	break;
+    case INVALIDATE:
+	asm volatile ("mcr p15, 0, %0, c7, c6, 2" : : "r"(x) : "memory");
+	break;
+    case CLEAN_INVALIDATE:
+	asm volatile ("mcr p15, 0, %0, c7, c14, 2" : : "r"(x) : "memory");
+	break;
+    }
+}
+
+static void whole(Op op) {
+    dsb();
+    if (!armv7) {
+	// ARM1176 entire data cache operations
+	switch (op) {
+	case CLEAN:
+	    asm volatile ("mcr p15, 0, %0, c7, c10, 0" : : "r"(0) : "memory");
+	    break;
+	case INVALIDATE:
+	    asm volatile ("mcr p15, 0, %0, c7, c6, 0" : : "r"(0) : "memory");
+	    break;
+	case CLEAN_INVALIDATE:
+	    asm volatile ("mcr p15, 0, %0, c7, c14, 0" : : "r"(0) : "memory");
+	    break;
+	}
+	dsb();
+	return;
+    }
+    // innermost level first so dirty lines move outwards
+    for (uint32_t n = 0; n < num_levels; ++n) {
+	const Level &l = level[n];
+	for (uint32_t way = 0; way < l.ways; ++way) {
+	    for (uint32_t set = 0; set < l.sets; ++set) {
+		set_way(op, (way << l.way_shift) | (set << l.line_shift)
+			| (n << 1));
+	    }
+	}
+	dsb();
+    }
+}
+
+void clean_all() {
+    whole(CLEAN);
+}
+
+void clean_invalidate_all() {
+    whole(CLEAN_INVALIDATE);
+}
+
+void invalidate_all() {
+    whole(INVALIDATE);
+}
+
+__END_NAMESPACE(Cache);
+__END_NAMESPACE(Kernel);
@@ -0,0 +1,78 @@
+/* Copyright (C) 2015 Goswin von Brederlow <goswin-v-b@web.de>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+/* Data and instruction cache maintenance
+ *
+ * Range operations work on every cache line overlapping the range and
+ * nothing else. They go to the point of coherency, so devices reading or
+ * writing memory directly (DMA, the VC mailbox) see the same data as the
+ * cores:
+ *
+ *   clean_range()            before a device reads a buffer
+ *   invalidate_range()       after a device wrote a buffer
+ *   clean_invalidate_range() buffers going both ways
+ *
+ * Lines only partially covered at either end of invalidate_range() are
+ * cleaned and invalidated instead, so dirty data around the buffer is not
+ * lost. Device buffers should be cache line aligned anyway.
+ *
+ * The whole cache operations work by set/way on the Cortex-A7, for every
+ * level up to the point of coherency, and with the entire cache
+ * operations on the ARM1176. They only affect the calling core.
+ *
+ * Line sizes and set/way geometry are read from CTR and CCSIDR once.
+ */
+
+#ifndef KERNEL_MEMORY_CACHE_H
+#define KERNEL_MEMORY_CACHE_H 1
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/cdefs.h>
+
+__BEGIN_NAMESPACE(Kernel);
+__BEGIN_NAMESPACE(Cache);
+
+// smallest data and instruction cache line in bytes
+uint32_t dcache_line();
+uint32_t icache_line();
+
+void clean_range(const void *start, size_t size);
+
+/* clean_range() without the DSB before and after
+ * For cleaning many small ranges (page table entries) followed by a single
+ * DSB of the caller.
+ */
+void clean_lines(const void *start, size_t size);
+void invalidate_range(const void *start, size_t size);
+void clean_invalidate_range(const void *start, size_t size);
+
+// make code written through the data cache executable
+void sync_icache_range(const void *start, size_t size);
+
+void clean_all();
+void clean_invalidate_all();
+
+/* discard the contents of all data caches, dirty lines are lost
+ * Only for bringing up a core whose caches hold garbage.
+ */
+void invalidate_all();
+
+__END_NAMESPACE(Cache);
+__END_NAMESPACE(Kernel);
+
+#endif // #ifndef KERNEL_MEMORY_CACHE_H
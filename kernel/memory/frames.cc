@@ -0,0 +1,286 @@
+/* Copyright (C) 2015 Goswin von Brederlow <goswin-v-b@web.de>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+/* Physical page frame allocator
+ */
+
+#include "frames.h"
+#include "pagetable.h"
+#include "physmap.h"
+#include "../assert.h"
+#include "../core.h"
+#include "../irq.h"
+#include "../kprintf.h"
+#include "../init_priorities.h"
+#include "../spinlock.h"
+
+__BEGIN_NAMESPACE(Kernel);
+__BEGIN_NAMESPACE(Memory);
+
+extern "C" {
+    extern char _end[]; // physical end of the kernel image and boot tables
+};
+
+enum {
+    NO_PAGE = (1U << 20) - 1, // end of list marker
+};
+
+// per core cache of free pages, lives in the COREn_PRIVATE window
+struct Magazine {
+    uint32_t count;
+    uint32_t pfn[FRAME_MAGAZINE];
+};
+
+static Magazine & magazine(uint32_t core) {
+    return *(Magazine *)Core::private_addr(core, PRIVATE_FRAMES);
+}
+
+// global pool, protected by lock
+static SpinLock lock;
+static uint32_t num_pages;
+static uint32_t num_free;
+static uint32_t free_orders; // bit n set when free_list[n] is not empty
+static uint32_t free_list[MAX_ORDER];
+// magazines are mapped, before that single pages come from the pool
+static bool magazines_ready;
+
+static uint32_t page_align(uint32_t x) {
+    return (x + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1);
+}
+
+static void push(uint32_t pfn, uint32_t order) {
+    PageInfo &info = page_info[pfn];
+    uint32_t head = free_list[order];
+    info.free = 1;
+    info.order = order;
+    info.prev = NO_PAGE;
+    info.next = head;
+    if (head != NO_PAGE) {
+	page_info[head].prev = pfn;
+    }
+    free_list[order] = pfn;
+    free_orders |= 1U << order;
+}
+
+static void remove(uint32_t pfn, uint32_t order) {
+    PageInfo &info = page_info[pfn];
+    if (info.prev == NO_PAGE) {
+	free_list[order] = info.next;
+	if (info.next == NO_PAGE) {
+	    free_orders &= ~(1U << order);
+	}
+    } else {
+	page_info[info.prev].next = info.next;
+    }
+    if (info.next != NO_PAGE) {
+	page_info[info.next].prev = info.prev;
+    }
+    info.free = 0;
+}
+
+static uint32_t alloc_locked(uint32_t order) {
+    // smallest non-empty free list of at least the requested order
+    uint32_t avail = free_orders & ~((1U << order) - 1);
+    if (avail == 0) {
+	return NO_PAGE;
+    }
+    uint32_t found = __builtin_ctz(avail);
+    uint32_t pfn = free_list[found];
+    remove(pfn, found);
+
+    // split the block, returning the upper halves
+    while (found > order) {
+	--found;
+	push(pfn + (1U << found), found);
+    }
+    page_info[pfn].order = order;
+    num_free -= 1U << order;
+    return pfn;
+}
+
+static void free_locked(uint32_t pfn, uint32_t order) {
+    num_free += 1U << order;
+
+    // merge with free buddies as long as possible
+    while (order < MAX_ORDER - 1) {
+	uint32_t buddy = pfn ^ (1U << order);
+	if (buddy >= num_pages) break;
+	const PageInfo &info = page_info[buddy];
+	if (!info.free || info.order != order) break;
+	remove(buddy, order);
+	pfn &= ~(1U << order);
+	++order;
+    }
+    push(pfn, order);
+}
+
+PhysAddr alloc_frames(uint32_t order) {
+    if (order == 0) {
+	return alloc_frame();
+    }
+    IRQ::Guard guard;
+    Locked locked(lock);
+    uint32_t pfn = alloc_locked(order);
+    return (pfn == NO_PAGE) ? PhysAddr::NONE() : PhysAddr(pfn << PAGE_SHIFT);
+}
+
+void free_frames(PhysAddr phys, uint32_t order) {
+    if (order == 0) {
+	free_frame(phys);
+	return;
+    }
+    IRQ::Guard guard;
+    Locked locked(lock);
+    free_locked(phys.x >> PAGE_SHIFT, order);
+}
+
+PhysAddr alloc_frame() {
+    IRQ::Guard guard;
+    if (!magazines_ready) {
+	// mapping the magazines may need frames for LeafTables
+	Locked locked(lock);
+	uint32_t pfn = alloc_locked(0);
+	return (pfn == NO_PAGE) ? PhysAddr::NONE() : PhysAddr(pfn << PAGE_SHIFT);
+    }
+    Magazine &mag = magazine(Core::id());
+    if (mag.count == 0) {
+	// refill half the magazine from the global pool
+	Locked locked(lock);
+	while (mag.count < FRAME_BATCH) {
+	    uint32_t pfn = alloc_locked(0);
+	    if (pfn == NO_PAGE) break;
+	    mag.pfn[mag.count++] = pfn;
+	}
+	if (mag.count == 0) {
+	    return PhysAddr::NONE();
+	}
+    }
+    return PhysAddr(mag.pfn[--mag.count] << PAGE_SHIFT);
+}
+
+void free_frame(PhysAddr phys) {
+    IRQ::Guard guard;
+    if (!magazines_ready) {
+	Locked locked(lock);
+	free_locked(phys.x >> PAGE_SHIFT, 0);
+	return;
+    }
+    Magazine &mag = magazine(Core::id());
+    if (mag.count == FRAME_MAGAZINE) {
+	// drain the oldest half of the magazine to the global pool
+	Locked locked(lock);
+	for (uint32_t i = 0; i < FRAME_BATCH; ++i) {
+	    free_locked(mag.pfn[i], 0);
+	}
+	for (uint32_t i = FRAME_BATCH; i < FRAME_MAGAZINE; ++i) {
+	    mag.pfn[i - FRAME_BATCH] = mag.pfn[i];
+	}
+	mag.count -= FRAME_BATCH;
+    }
+    mag.pfn[mag.count++] = phys.x >> PAGE_SHIFT;
+}
+
+void share_frame(PhysAddr phys) {
+    IRQ::Guard guard;
+    Locked locked(lock);
+    PageInfo &info = page_info[phys.x >> PAGE_SHIFT];
+    assert(info.shares < (1U << 12) - 1);
+    ++info.shares;
+}
+
+uint32_t frame_shares(PhysAddr phys) {
+    return page_info[phys.x >> PAGE_SHIFT].shares;
+}
+
+void release_frame(PhysAddr phys) {
+    {
+	IRQ::Guard guard;
+	Locked locked(lock);
+	PageInfo &info = page_info[phys.x >> PAGE_SHIFT];
+	if (info.shares > 0) {
+	    --info.shares;
+	    return;
+	}
+    }
+    free_frame(phys);
+}
+
+uint32_t free_pages() {
+    uint32_t res = num_free;
+    for (uint32_t core = 0; core < Core::count(); ++core) {
+	res += magazine(core).count;
+    }
+    return res;
+}
+
+// give the pages [start, end) to the allocator in maximal aligned blocks
+static void add_range(uint32_t start, uint32_t end) {
+    while (start < end) {
+	uint32_t order = MAX_ORDER - 1;
+	while ((start & ((1U << order) - 1)) != 0
+	       || start + (1U << order) > end) {
+	    --order;
+	}
+	push(start, order);
+	num_free += 1U << order;
+	start += 1U << order;
+    }
+}
+
+CONSTRUCTOR(FRAMES) {
+    for (uint32_t order = 0; order < MAX_ORDER; ++order) {
+	free_list[order] = NO_PAGE;
+    }
+    num_pages = PhysMap::usable_end() >> PAGE_SHIFT;
+
+    // page descriptors go directly after the kernel image
+    uint32_t info_phys = page_align(uint32_t(_end));
+    uint32_t info_size = page_align(num_pages * sizeof(PageInfo));
+    const PhysMap::Range *after = PhysMap::find(PhysAddr(info_phys));
+    assert(after != nullptr && after->type == PhysMap::MEM_USABLE
+	   && after->end >= info_phys + info_size);
+    PhysMap::add(info_phys, info_size, PhysMap::MEM_KERNEL);
+    map_range(PhysAddr(info_phys), (const void *)PER_PAGE_INFO, info_size,
+	      KERNEL_WRITE);
+    for (uint32_t pfn = 0; pfn < num_pages; ++pfn) {
+	page_info[pfn] = PageInfo();
+    }
+
+    // everything the memory map still calls usable is free
+    for (uint32_t num = 0; num < PhysMap::count(); ++num) {
+	const PhysMap::Range &range = PhysMap::range(num);
+	if (range.type != PhysMap::MEM_USABLE) continue;
+	map_range(PhysAddr(range.start), phys_to_virt(PhysAddr(range.start)),
+		  range.end - range.start, KERNEL_WRITE);
+	add_range(range.start >> PAGE_SHIFT, range.end >> PAGE_SHIFT);
+    }
+
+    // map a magazine into the private window of every core
+    for (uint32_t core = 0; core < Core::count(); ++core) {
+	uint32_t pfn = alloc_locked(0);
+	assert(pfn != NO_PAGE);
+	map(PhysAddr(pfn << PAGE_SHIFT), Core::private_addr(core, PRIVATE_FRAMES),
+	    KERNEL_WRITE);
+	magazine(core).count = 0;
+    }
+    magazines_ready = true;
+
+    kprintf("Frames      : %lu of %lu pages free\n", num_free, num_pages);
+} CONSTRUCTOR_END
+
+__END_NAMESPACE(Memory);
+__END_NAMESPACE(Kernel);
@@ -0,0 +1,99 @@
+/* Copyright (C) 2015 Goswin von Brederlow <goswin-v-b@web.de>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+/* Physical page frame allocator
+ *
+ * Buddy allocator over all of RAM. Every page has a PageInfo descriptor in
+ * the array at PER_PAGE_INFO. Free blocks are kept in one doubly linked list
+ * per order, linked through the descriptors, and a bitmap of non-empty
+ * orders picks the list to split from without walking anything.
+ *
+ * Single pages are served from a small per core magazine in the core's
+ * COREn_PRIVATE window. Magazines refill from and drain to the global pool
+ * in batches, so only one in every FRAME_BATCH allocations takes the lock.
+ */
+
+#ifndef KERNEL_MEMORY_FRAMES_H
+#define KERNEL_MEMORY_FRAMES_H 1
+
+#include <stdint.h>
+#include <sys/cdefs.h>
+#include "fixed_addresses.h"
+#include "PhysAddr.h"
+
+__BEGIN_NAMESPACE(Kernel);
+__BEGIN_NAMESPACE(Memory);
+
+enum {
+    MAX_ORDER = 11, // blocks of 1 to 1024 pages (4k to 4M)
+    FRAME_MAGAZINE = 64, // pages cached per core
+    FRAME_BATCH = 32, // pages moved between magazine and global pool
+};
+
+// descriptor for every physical page, indexed by page frame number
+struct PageInfo {
+    uint32_t next  : 20; // next free block of the same order
+    uint32_t order : 5;  // order of the block starting at this page
+    uint32_t free  : 1;  // page is the head of a free block
+    uint32_t slab  : 1;  // page belongs to a slab of the kernel heap
+    uint32_t       : 5;
+    uint32_t prev  : 20; // previous free block of the same order
+    uint32_t shares : 12; // address spaces sharing the page besides one
+};
+
+static PageInfo * const page_info = (PageInfo *)PER_PAGE_INFO;
+
+/* allocate 2^order physically contiguous and aligned pages
+ * Returns PhysAddr::NONE() when no block of that size is free.
+ */
+PhysAddr alloc_frames(uint32_t order);
+
+// return a block allocated with alloc_frames() with the same order
+void free_frames(PhysAddr phys, uint32_t order);
+
+// allocate a single page from the magazine of the current core
+PhysAddr alloc_frame();
+
+// return a single page to the magazine of the current core
+void free_frame(PhysAddr phys);
+
+// one more address space maps the page copy-on-write
+void share_frame(PhysAddr phys);
+
+// number of address spaces sharing the page besides the first
+uint32_t frame_shares(PhysAddr phys);
+
+// drop one mapping of a page, frees it when it was the last
+void release_frame(PhysAddr phys);
+
+// number of free pages, including the ones cached in magazines
+uint32_t free_pages();
+
+// all RAM given to the allocator is mapped at PHYS_TO_VIRT
+static inline void * phys_to_virt(PhysAddr phys) {
+    return (void *)(phys.x + PHYS_TO_VIRT);
+}
+
+// inverse of phys_to_virt(), only valid for that mapping
+static inline PhysAddr direct_to_phys(const void *virt) {
+    return PhysAddr(uintptr_t(virt) - PHYS_TO_VIRT);
+}
+
+__END_NAMESPACE(Memory);
+__END_NAMESPACE(Kernel);
+
+#endif // #ifndef KERNEL_MEMORY_FRAMES_H
@@ -0,0 +1,406 @@
+/* Copyright (C) 2015 Goswin von Brederlow <goswin-v-b@web.de>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+/* Kernel virtual address allocator
+ */
+
+#include "kva.h"
+#include "frames.h"
+#include "slab.h"
+#include "LeafEntry.h"
+#include "fixed_addresses.h"
+#include "../assert.h"
+#include "../core.h"
+#include "../irq.h"
+#include "../kprintf.h"
+#include "../init_priorities.h"
+#include "../spinlock.h"
+
+__BEGIN_NAMESPACE(Kernel);
+__BEGIN_NAMESPACE(KVA);
+
+using Memory::PAGE_SIZE;
+using Memory::PhysAddr;
+
+// free range in the treap, ordered by start, heap ordered by prio
+struct Node {
+    uintptr_t start;
+    size_t size;
+    size_t largest; // largest size in the subtree
+    uint32_t prio;
+    Node *left;
+    Node *right;
+};
+
+static SpinLock lock;
+static Node *root;
+static size_t free_bytes;
+static uint32_t seed = 0x2545F491;
+
+static uint32_t next_prio() {
+    // xorshift32
+    seed ^= seed << 13;
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+    return seed;
+}
+
+static size_t page_align(size_t x) {
+    return (x + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1);
+}
+
+static size_t largest(const Node *node) {
+    return node ? node->largest : 0;
+}
+
+static void update(Node *node) {
+    size_t l = largest(node->left), r = largest(node->right);
+    node->largest = node->size;
+    if (l > node->largest) node->largest = l;
+    if (r > node->largest) node->largest = r;
+}
+
+// split into the nodes starting before key and the rest
+static void split(Node *node, uintptr_t key, Node *&before, Node *&after) {
+    if (node == nullptr) {
+	before = after = nullptr;
+	return;
+    }
+    if (node->start < key) {
+	split(node->right, key, node->right, after);
+	before = node;
+    } else {
+	split(node->left, key, before, node->left);
+	after = node;
+    }
+    update(node);
+}
+
+// join two treaps, all of before start lower than all of after
+static Node * merge(Node *before, Node *after) {
+    if (before == nullptr) return after;
+    if (after == nullptr) return before;
+    if (before->prio > after->prio) {
+	before->right = merge(before->right, after);
+	update(before);
+	return before;
+    }
+    after->left = merge(before, after->left);
+    update(after);
+    return after;
+}
+
+static Node * take_first(Node *&node) {
+    if (node->left == nullptr) {
+	Node *first = node;
+	node = node->right;
+	first->right = nullptr;
+	update(first);
+	return first;
+    }
+    Node *first = take_first(node->left);
+    update(node);
+    return first;
+}
+
+static Node * take_last(Node *&node) {
+    if (node->right == nullptr) {
+	Node *last = node;
+	node = node->left;
+	last->left = nullptr;
+	update(last);
+	return last;
+    }
+    Node *last = take_last(node->right);
+    update(node);
+    return last;
+}
+
+static void insert(Node *node, uintptr_t start, size_t size) {
+    node->start = start;
+    node->size = size;
+    node->prio = next_prio();
+    node->left = node->right = nullptr;
+    update(node);
+    Node *before, *after;
+    split(root, start, before, after);
+    root = merge(merge(before, node), after);
+}
+
+static void erase(Node *&node, uintptr_t start) {
+    if (node->start == start) {
+	node = merge(node->left, node->right);
+	return;
+    }
+    erase(start < node->start ? node->left : node->right, start);
+    update(node);
+}
+
+// lowest free range of at least size bytes
+static Node * first_fit(size_t size) {
+    Node *node = root;
+    while (node != nullptr && node->largest >= size) {
+	if (largest(node->left) >= size) {
+	    node = node->left;
+	} else if (node->size >= size) {
+	    return node;
+	} else {
+	    node = node->right;
+	}
+    }
+    return nullptr;
+}
+
+/* take [start, start + size) out of the free range node, which is no
+ * longer in the treap
+ * The pieces left on either side go back into the treap in node and, if
+ * there are two, in spare, which is then set to nullptr. Returns node when
+ * it is not needed.
+ */
+static Node * carve(Node *node, uintptr_t start, size_t size, Node *&spare) {
+    uintptr_t node_start = node->start;
+    uintptr_t node_end = node->start + node->size;
+    uintptr_t end = start + size;
+    free_bytes -= size;
+    if (node_start < start) {
+	insert(node, node_start, start - node_start);
+	node = nullptr;
+    }
+    if (end < node_end) {
+	if (node == nullptr) {
+	    node = spare;
+	    spare = nullptr;
+	}
+	insert(node, end, node_end - end);
+	node = nullptr;
+    }
+    return node;
+}
+
+void * alloc(size_t size, size_t align) {
+    assert(size > 0 && size % PAGE_SIZE == 0 && align % PAGE_SIZE == 0);
+    // taken out of the lock, kmalloc might need address space itself
+    Node *spare = Memory::create<Node>();
+    Node *unused = nullptr;
+    uintptr_t start = 0;
+    {
+	IRQ::Guard guard;
+	Locked locked(lock);
+	// any range this large fits however its start is aligned
+	Node *node = first_fit(size + align - PAGE_SIZE);
+	if (node != nullptr) {
+	    start = (node->start + align - 1) & ~(align - 1);
+	    bool both = node->start < start
+		&& start + size < node->start + node->size;
+	    if (!both || spare != nullptr) {
+		erase(root, node->start);
+		unused = carve(node, start, size, spare);
+	    } else {
+		start = 0;
+	    }
+	}
+    }
+    Memory::destroy(unused);
+    Memory::destroy(spare);
+    return (void *)start;
+}
+
+void free(const void *virt, size_t size) {
+    assert(size > 0 && size % PAGE_SIZE == 0);
+    uintptr_t start = uintptr_t(virt), end = start + size;
+    Node *node = Memory::create<Node>();
+    Node *unused[2] = {nullptr, nullptr};
+    {
+	IRQ::Guard guard;
+	Locked locked(lock);
+	Node *before, *after;
+	split(root, start, before, after);
+	Node *prev = before ? take_last(before) : nullptr;
+	Node *next = after ? take_first(after) : nullptr;
+	assert(prev == nullptr || prev->start + prev->size <= start);
+	assert(next == nullptr || end <= next->start);
+	free_bytes += size;
+
+	// merge with the free neighbours
+	if (prev != nullptr && prev->start + prev->size == start) {
+	    start = prev->start;
+	    unused[0] = node;
+	    node = prev;
+	} else if (prev != nullptr) {
+	    before = merge(before, prev);
+	}
+	if (next != nullptr && next->start == end) {
+	    end = next->start + next->size;
+	    if (node == nullptr) {
+		// out of memory for the node, widen next downward instead
+		node = next;
+	    } else {
+		unused[1] = next;
+	    }
+	} else if (next != nullptr) {
+	    after = merge(next, after);
+	}
+
+	if (node != nullptr) {
+	    node->start = start;
+	    node->size = end - start;
+	    node->left = node->right = nullptr;
+	    node->prio = next_prio();
+	    update(node);
+	    before = merge(before, node);
+	} else {
+	    // out of memory for the node and no neighbour, the range is lost
+	    free_bytes -= end - start;
+	}
+	root = merge(before, after);
+    }
+    Memory::destroy(unused[0]);
+    Memory::destroy(unused[1]);
+}
+
+bool reserve(const void *virt, size_t size) {
+    assert(size > 0 && size % PAGE_SIZE == 0);
+    uintptr_t start = uintptr_t(virt);
+    Node *spare = Memory::create<Node>();
+    Node *unused = nullptr;
+    bool found = false;
+    {
+	IRQ::Guard guard;
+	Locked locked(lock);
+	// the free range containing start is the last one starting before
+	Node *before, *after;
+	split(root, start + 1, before, after);
+	Node *node = before ? take_last(before) : nullptr;
+	root = merge(before, after);
+	if (node != nullptr) {
+	    if (start + size <= node->start + node->size
+		&& (spare != nullptr || node->start == start
+		    || start + size == node->start + node->size)) {
+		unused = carve(node, start, size, spare);
+		found = true;
+	    } else {
+		insert(node, node->start, node->size);
+	    }
+	}
+    }
+    Memory::destroy(unused);
+    Memory::destroy(spare);
+    return found;
+}
+
+// unmap pages mapped by map_frames() and free their frames
+static void unmap_frames(char *virt, size_t size) {
+    for (size_t off = 0; off < size; off += PAGE_SIZE) {
+	const Memory::LeafEntry &entry = Memory::leaf_entry(virt + off);
+	PhysAddr frame(entry.raw() & Memory::LeafEntry::Addr::MASK);
+	Memory::unmap_range(virt + off, PAGE_SIZE);
+	Memory::free_frame(frame);
+    }
+}
+
+// back size bytes at virt with fresh frames
+static bool map_frames(char *virt, size_t size) {
+    for (size_t off = 0; off < size; off += PAGE_SIZE) {
+	PhysAddr frame = Memory::alloc_frame();
+	if (!frame.valid()) {
+	    unmap_frames(virt, off);
+	    return false;
+	}
+	Memory::map(frame, virt + off, Memory::KERNEL_WRITE);
+    }
+    return true;
+}
+
+void * alloc_stack(size_t size) {
+    size = page_align(size);
+    char *guard = (char *)alloc(PAGE_SIZE + size);
+    if (guard == nullptr) return nullptr;
+    if (!map_frames(guard + PAGE_SIZE, size)) {
+	free(guard, PAGE_SIZE + size);
+	return nullptr;
+    }
+    return guard + PAGE_SIZE + size;
+}
+
+void free_stack(void *top, size_t size) {
+    size = page_align(size);
+    char *bottom = (char *)top - size;
+    unmap_frames(bottom, size);
+    free(bottom - PAGE_SIZE, PAGE_SIZE + size);
+}
+
+void * alloc_buffer(size_t size) {
+    size = page_align(size);
+    char *buf = (char *)alloc(size + PAGE_SIZE);
+    if (buf == nullptr) return nullptr;
+    if (!map_frames(buf, size)) {
+	free(buf, size + PAGE_SIZE);
+	return nullptr;
+    }
+    return buf;
+}
+
+void free_buffer(void *buf, size_t size) {
+    size = page_align(size);
+    unmap_frames((char *)buf, size);
+    free(buf, size + PAGE_SIZE);
+}
+
+void * map_temp(PhysAddr phys, Memory::Mode mode) {
+    void *virt = alloc(PAGE_SIZE);
+    if (virt != nullptr) Memory::map(phys, virt, mode);
+    return virt;
+}
+
+void unmap_temp(void *virt) {
+    Memory::unmap_range(virt, PAGE_SIZE);
+    free(virt, PAGE_SIZE);
+}
+
+size_t free_space() {
+    IRQ::Guard guard;
+    Locked locked(lock);
+    return free_bytes;
+}
+
+size_t largest_free() {
+    IRQ::Guard guard;
+    Locked locked(lock);
+    return largest(root);
+}
+
+CONSTRUCTOR(KVA) {
+    free((const void *)KERNEL_VA_START, KERNEL_VA_END - KERNEL_VA_START);
+
+    // the hand placed windows from fixed_addresses.h
+    const uintptr_t CORE_WINDOW = CORE1_PRIVATE - CORE0_PRIVATE;
+    bool fixed =
+	reserve((const void *)KERNEL_VA_START, Core::MAX_CORES * CORE_WINDOW)
+	&& reserve((const void *)COMMON_TIME_PAGE, 0x00002000)
+	&& reserve((const void *)KERNEL_PAGETABLE,
+		   KERNEL_LEAFTABLES + 0x00400000 - KERNEL_PAGETABLE)
+	&& reserve((const void *)KERNEL_PERIPHERALS, 0x01000000)
+	&& reserve((const void *)KERNEL_LOCAL_PERIPHERALS, 0x00100000)
+	&& reserve((const void *)PER_PAGE_INFO, 0x00400000);
+    assert(fixed);
+
+    kprintf("KVA         : %lu MB free, largest range %lu MB\n",
+	    uint32_t(free_space() >> 20), uint32_t(largest_free() >> 20));
+} CONSTRUCTOR_END
+
+__END_NAMESPACE(KVA);
+__END_NAMESPACE(Kernel);
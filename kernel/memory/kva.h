@@ -0,0 +1,78 @@
+/* Copyright (C) 2015 Goswin von Brederlow <goswin-v-b@web.de>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+/* Kernel virtual address allocator
+ *
+ * Hands out page aligned ranges of the kernel address space between
+ * KERNEL_VA_START and KERNEL_VA_END that are not one of the fixed windows
+ * from fixed_addresses.h. The free ranges are kept in a treap ordered by
+ * address, every node also knows the largest free range in its subtree.
+ * alloc() takes the lowest range that fits and free() merges the range
+ * with its free neighbours, both in O(log n) expected time, so released
+ * space is reused without fragmenting into ever smaller pieces.
+ *
+ * On top of that are stacks and buffers backed by fresh frames with an
+ * unmapped guard page, below the stack and after the buffer, and single
+ * page slots to map a frame temporarily.
+ */
+
+#ifndef KERNEL_MEMORY_KVA_H
+#define KERNEL_MEMORY_KVA_H 1
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/cdefs.h>
+#include "PhysAddr.h"
+#include "pagetable.h"
+
+__BEGIN_NAMESPACE(Kernel);
+__BEGIN_NAMESPACE(KVA);
+
+/* reserve size bytes of address space aligned to align, both multiples
+ * of PAGE_SIZE, nothing is mapped
+ * Returns nullptr when no free range is large enough.
+ */
+void * alloc(size_t size, size_t align = Memory::PAGE_SIZE);
+
+// return a range from alloc(), must be unmapped already
+void free(const void *virt, size_t size);
+
+// take a specific range out of the free space, false if not all free
+bool reserve(const void *virt, size_t size);
+
+/* stack of size bytes with an unmapped guard page below it
+ * Returns the top of the stack or nullptr.
+ */
+void * alloc_stack(size_t size);
+void free_stack(void *top, size_t size);
+
+// buffer of size bytes with an unmapped guard page after it or nullptr
+void * alloc_buffer(size_t size);
+void free_buffer(void *buf, size_t size);
+
+// map a single frame at a free page until unmap_temp()
+void * map_temp(Memory::PhysAddr phys, Memory::Mode mode);
+void unmap_temp(void *virt);
+
+// bytes of address space not handed out and the largest free range
+size_t free_space();
+size_t largest_free();
+
+__END_NAMESPACE(KVA);
+__END_NAMESPACE(Kernel);
+
+#endif // #ifndef KERNEL_MEMORY_KVA_H
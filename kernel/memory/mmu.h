@@ -0,0 +1,87 @@
+/* Copyright (C) 2015 Goswin von Brederlow <goswin-v-b@web.de>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+/* CP15 primitives for page table maintenance, TLB operations are in tlb.h
+ * and the cache operations the table helpers below use in cache.h.
+ */
+
+#ifndef KERNEL_MEMORY_MMU_H
+#define KERNEL_MEMORY_MMU_H 1
+
+#include <stdint.h>
+#include <sys/cdefs.h>
+#include "PhysAddr.h"
+#include "cache.h"
+
+__BEGIN_NAMESPACE(Kernel);
+__BEGIN_NAMESPACE(Memory);
+
+enum {
+    // page table walk inner and outer write-back, write-allocate,
+    // cacheable, shareable (same as boot.S)
+    TTBR_WALK_ATTR = 0b1001010,
+};
+
+/* clean data cache line containing virt so the table walk sees the change
+ * No barriers, the walk only sees the entries after the caller's DSB.
+ */
+static inline void clean_dcache_line(const void *virt) {
+    Cache::clean_lines(virt, 1);
+}
+
+static inline void clean_dcache_range(const void *start, const void *end) {
+    Cache::clean_lines(start, (const char *)end - (const char *)start);
+}
+
+/* translate virt with the current tables like a privileged read (ATS1CPR)
+ * Returns the PAR: bit 0 set when the translation aborted, otherwise the
+ * physical page in bits 31 - 12. IRQs are masked so no handler can reuse
+ * the PAR between the translation and the read.
+ */
+static inline uint32_t translate_kernel_read(const void *virt) {
+    uint32_t cpsr, par;
+    asm volatile ("mrs %0, cpsr\n"
+		  "\tcpsid i\n"
+		  "\tmcr p15, 0, %2, c7, c8, 0\n"
+		  "\tmcr p15, 0, %3, c7, c5, 4\n" // isb
+		  "\tmrc p15, 0, %1, c7, c4, 0\n"
+		  "\tmsr cpsr_c, %0"
+		  : "=&r"(cpsr), "=&r"(par) : "r"(virt), "r"(0) : "memory");
+    return par;
+}
+
+// ASID of the running address space, 0 while no user space is active
+static inline uint32_t current_asid() {
+    uint32_t context;
+    asm volatile ("mrc p15, 0, %0, c13, c0, 1" : "=r"(context));
+    return context & 0xFF;
+}
+
+static inline void set_context_id(uint32_t context) {
+    asm volatile ("mcr p15, 0, %0, c13, c0, 1" : : "r"(context) : "memory");
+}
+
+// user page table, TTBCR.N = 2 makes it a 4k table covering 0 - 1G
+static inline void set_ttbr0(PhysAddr table) {
+    asm volatile ("mcr p15, 0, %0, c2, c0, 0"
+		  : : "r"(table.x | TTBR_WALK_ATTR) : "memory");
+}
+
+__END_NAMESPACE(Memory);
+__END_NAMESPACE(Kernel);
+
+#endif // #ifndef KERNEL_MEMORY_MMU_H
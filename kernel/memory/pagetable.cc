@@ -20,14 +20,42 @@
 
 #include "pagetable.h"
 #include <stdint.h>
+#include <string.h>
+#include "asm.h"
 #include "fixed_addresses.h"
 #include "TableEntry.h"
+#include "SectionEntry.h"
 #include "LeafEntry.h"
+#include "LargePageEntry.h"
 #include "PhysAddr.h"
+#include "mmu.h"
+#include "translate.h"
+#include "tlb.h"
+#include "frames.h"
+#include "../assert.h"
+#include "../irq.h"
+#include "../spinlock.h"
 
 __BEGIN_NAMESPACE(Kernel);
 __BEGIN_NAMESPACE(Memory);
 
+extern "C" {
+    // physical address of the LeafTable frames reserved in boot.S
+    extern char boot_leaf_tables[];
+};
+
+enum {
+    LEAF_TABLE_SIZE = 1024,
+    // LeafTables come in frames of 4, covering a 4M group
+    GROUP_SHIFT = 22,
+};
+
+// kernel page table updates (and boot_leaf_used), protected by lock
+static SpinLock lock;
+
+// frames of boot_leaf_tables not used by boot.S, taken first
+static uint32_t boot_leaf_used = BOOT_LEAF_GROUPS;
+
 struct KernelPageTable {
     TableEntry entry[4096];
     TableEntry & operator[](const void * const virt) {
@@ -52,8 +80,16 @@ const TableEntry & table_entry(const void * const virt) {
     return kernel_pagetable[virt];
 }
 
+const SectionEntry section_entry(const void * const virt) {
+    const TableEntry &entry = kernel_pagetable[virt];
+    if (!entry.is_section()) {
+	return SectionEntry::FAULT();
+    }
+    return SectionEntry(RAW, entry.raw());
+}
+
 const LeafEntry & leaf_entry(const void * const virt) {
-    if (kernel_pagetable[virt] == TableEntry::FAULT()) {
+    if (!kernel_pagetable[virt].is_table()) {
 	return LeafEntry::FAULT();
     }
     return kernel_leaftables[virt];
@@ -67,42 +103,45 @@ static const char * const MODE_NAME[] = {
     "FRAMEBUFFER",
     "PERIPHERAL",
     "KERNEL_PERIPHERAL",
+    "COMMON_READ",
+    "COMMON_PERIPHERAL",
+    "UNKNOWN",
 };
 
+const char * mode_name(Mode mode) {
+    return MODE_NAME[mode];
+}
+
 // FIXME
 void panic(const char * const format, ...) {
     (void)format;
 }
 
-void map(PhysAddr phys, const void * const virt, Mode mode) {
-    if (kernel_pagetable[virt] == TableEntry::FAULT()) {
-	panic("%s(%#10.8X, %p, %s): no LeafTable", phys.x, virt, MODE_NAME[mode]);
-    }
-    LeafEntry & entry = kernel_leaftables[virt];
-    if (entry != LeafEntry::FAULT()) {
-	panic("%s(%#10.8X, %p, %s): double map", phys.x, virt, MODE_NAME[mode]);
-    }
+// bits for each Mode, the same for all types of entries
+template<typename Entry>
+static typename Entry::M attributes(Mode mode) {
+    using M = typename Entry::M;
 
     // access rights to page
-    static constexpr const LeafEntry::Ap ACCESS_KERNEL_READ{0b101};
-    static constexpr const LeafEntry::Ap ACCESS_KERNEL_WRITE{0b001};
-    static constexpr const LeafEntry::Ap ACCESS_USER_READ{0b111};
-    static constexpr const LeafEntry::Ap ACCESS_USER_WRITE{0b011};
+    static constexpr const typename Entry::Ap ACCESS_KERNEL_READ{0b101};
+    static constexpr const typename Entry::Ap ACCESS_KERNEL_WRITE{0b001};
+    static constexpr const typename Entry::Ap ACCESS_USER_READ{0b111};
+    static constexpr const typename Entry::Ap ACCESS_USER_WRITE{0b011};
 
     // caching behaviour
-    static constexpr const LeafEntry::M CACHED{LeafEntry::Tex(0b101),
-	    !LeafEntry::CACHED, LeafEntry::BUFFERED};
-    static constexpr const LeafEntry::M WRITE_THROUGH{LeafEntry::Tex(0b110),
-	    LeafEntry::CACHED, !LeafEntry::BUFFERED};
-    static constexpr const LeafEntry::M PERIPHERAL{LeafEntry::Tex(0b000),
-	    !LeafEntry::CACHED, LeafEntry::BUFFERED};
+    static constexpr const M CACHED{typename Entry::Tex(0b101),
+	    !Entry::CACHED, Entry::BUFFERED};
+    static constexpr const M WRITE_THROUGH{typename Entry::Tex(0b110),
+	    Entry::CACHED, !Entry::BUFFERED};
+    static constexpr const M PERIPHERAL{typename Entry::Tex(0b000),
+	    !Entry::CACHED, Entry::BUFFERED};
 
     // other
-    static constexpr const LeafEntry::Global G = LeafEntry::GLOBAL;
-    static constexpr const LeafEntry::Shared S = LeafEntry::SHARED;
+    static constexpr const typename Entry::Global G = Entry::GLOBAL;
+    static constexpr const typename Entry::Shared S = Entry::SHARED;
     
     // combined mode
-    static constexpr const LeafEntry::M LEAF_MODE[] = {
+    static constexpr const M MODE[] = {
 	CACHED + ACCESS_KERNEL_READ + G + S,		// KERNEL_READ
 	CACHED + ACCESS_KERNEL_WRITE + G + S,		// KERNEL_WRITE
 	CACHED + ACCESS_USER_READ + !G + S,		// USER_READ
@@ -110,9 +149,373 @@ void map(PhysAddr phys, const void * const virt, Mode mode) {
 	WRITE_THROUGH + ACCESS_USER_WRITE + !G + S,	// FRAMEBUFFER
 	PERIPHERAL + ACCESS_KERNEL_WRITE + !G + S,	// PERIPHERAL
 	PERIPHERAL + ACCESS_KERNEL_WRITE + G + S,	// KERNEL_PERIPHERAL
+	CACHED + ACCESS_USER_READ + G + S,		// COMMON_READ
+	PERIPHERAL + ACCESS_USER_READ + G + S,		// COMMON_PERIPHERAL
     };
 
-    entry = LeafEntry(phys, LEAF_MODE[mode]);
+    return MODE[mode];
+}
+
+/* make changed entries for [virt, virt + size) visible
+ * Cleans the cache lines holding the entries once with a single DSB after
+ * all of them, then invalidates the range in the TLB, which adds the
+ * barriers or queues it in a TLB::Batch.
+ */
+static void sync_range(const char *virt, size_t size) {
+    if (size == 0) return;
+    uint32_t first = uintptr_t(virt) >> 20;
+    uint32_t last = (uintptr_t(virt) + size - 1) >> 20;
+    clean_dcache_range(&kernel_pagetable.entry[first],
+		       &kernel_pagetable.entry[last + 1]);
+    uint32_t first_page = uintptr_t(virt) >> PAGE_SHIFT;
+    uint32_t last_page = (uintptr_t(virt) + size - 1) >> PAGE_SHIFT;
+    for (uint32_t mb = first; mb <= last; ++mb) {
+	if (!kernel_pagetable.entry[mb].is_table()) continue;
+	uint32_t lo = mb << 8;
+	uint32_t hi = lo + 255;
+	if (lo < first_page) lo = first_page;
+	if (hi > last_page) hi = last_page;
+	clean_dcache_range(&kernel_leaftables.entry[lo],
+			   &kernel_leaftables.entry[hi + 1]);
+    }
+    dsb();
+    TLB::invalidate_range(virt, size, current_asid());
+}
+
+// LeafEntry in the window mapping the LeafTable frame of virt's 4M group
+static LeafEntry & group_window(const void *virt) {
+    const char *window = (const char *)KERNEL_LEAFTABLES
+	+ ((uintptr_t(virt) >> GROUP_SHIFT) << PAGE_SHIFT);
+    // the group of the window itself is always there (see boot.S)
+    return kernel_leaftables[window];
+}
+
+/* give the 4M group around virt a frame of 4 empty LeafTables
+ * The frame is only mapped into the KERNEL_LEAFTABLES window, the
+ * Pagetable entries are set by the caller as needed. Until the frame
+ * allocator is up (and for mapping its own magazines) the spare frames
+ * from boot.S are used.
+ */
+static void alloc_leaf_group(const void *virt) {
+    PhysAddr frame = PhysAddr::NONE();
+    if (boot_leaf_used < BOOT_LEAF_FRAMES) {
+	frame = PhysAddr(uint32_t(boot_leaf_tables)
+			 + boot_leaf_used++ * PAGE_SIZE);
+    } else {
+	frame = alloc_frame();
+    }
+    assert(frame.valid());
+
+    LeafEntry &window = group_window(virt);
+    window = LeafEntry(frame, attributes<LeafEntry>(KERNEL_WRITE));
+    // the entry was a fault before, so no TLB can hold it
+    clean_dcache_line(&window);
+    dsb();
+    isb();
+    char *tables = (char *)KERNEL_LEAFTABLES
+	+ ((uintptr_t(virt) >> GROUP_SHIFT) << PAGE_SHIFT);
+
+    memset(tables, 0, PAGE_SIZE);
+    clean_dcache_range(tables, tables + PAGE_SIZE);
+    // empty before any Pagetable entry can point there
+    dsb();
+}
+
+// physical address of the LeafTable for the MB containing virt
+static PhysAddr leaf_table_phys(const void *virt) {
+    LeafEntry &window = group_window(virt);
+    if (window == LeafEntry::FAULT()) {
+	alloc_leaf_group(virt);
+    }
+    uint32_t quarter = (uintptr_t(virt) >> 20) & ((1U << (GROUP_SHIFT - 20)) - 1);
+    return PhysAddr((window.raw() & LeafEntry::Addr::MASK)
+		    + quarter * LEAF_TABLE_SIZE);
+}
+
+/* point an unmapped MB at its LeafTable, allocating it when needed
+ * The entry is cleaned with the rest of the range by sync_range().
+ */
+static void ensure_leaf_table(const void *virt) {
+    TableEntry &table = kernel_pagetable[virt];
+    if (table == TableEntry::FAULT()) {
+	table = TableEntry(leaf_table_phys(virt));
+    }
+}
+
+// recover the Mode from the attribute bits of an entry
+template<typename Entry>
+static Mode mode_of(const Entry entry) {
+    uint32_t attr = entry.raw() & ~Entry::Addr::MASK;
+    for (int m = KERNEL_READ; m < MODE_UNKNOWN; ++m) {
+	if (Entry(PhysAddr(0), attributes<Entry>(Mode(m))).raw() == attr) {
+	    return Mode(m);
+	}
+    }
+    panic("%s(%#10.8X): unknown attributes", __FUNCTION__, entry.raw());
+    return KERNEL_READ;
+}
+
+static void set_large_page(const char *virt, const LargePageEntry entry) {
+    LeafEntry *leaf = &kernel_leaftables[virt];
+    for (uint32_t i = 0; i < LARGE_PAGE_SIZE / PAGE_SIZE; ++i) {
+	leaf[i] = LeafEntry(RAW, entry.raw());
+    }
+}
+
+/* replace the section containing virt by its LeafTable filled with large
+ * pages mapping the same memory, so part of it can be changed
+ */
+static void split_section(const char *virt) {
+    const char *base = (const char *)(uintptr_t(virt) & ~(SECTION_SIZE - 1));
+    TableEntry &table = kernel_pagetable[base];
+    SectionEntry section(RAW, table.raw());
+    PhysAddr phys(section.raw() & SectionEntry::Addr::MASK);
+    // the LeafTable is empty, nothing maps into it while the section exists
+    PhysAddr leaf_table = leaf_table_phys(base);
+    LargePageEntry::M attr = attributes<LargePageEntry>(mode_of(section));
+    for (uint32_t off = 0; off < SECTION_SIZE; off += LARGE_PAGE_SIZE) {
+	set_large_page(base + off,
+		       LargePageEntry(PhysAddr(phys.x + off), attr));
+    }
+    clean_dcache_range(&kernel_leaftables[base],
+		       &kernel_leaftables[base] + SECTION_SIZE / PAGE_SIZE);
+    dsb();
+    table = TableEntry(leaf_table);
+}
+
+// replace the large page containing virt by 16 small pages
+static void split_large_page(const char *virt) {
+    const char *base =
+	(const char *)(uintptr_t(virt) & ~(LARGE_PAGE_SIZE - 1));
+    LeafEntry *leaf = &kernel_leaftables[base];
+    LargePageEntry large(RAW, leaf->raw());
+    PhysAddr phys(large.raw() & LargePageEntry::Addr::MASK);
+    LeafEntry::M attr = attributes<LeafEntry>(mode_of(large));
+    for (uint32_t i = 0; i < LARGE_PAGE_SIZE / PAGE_SIZE; ++i) {
+	leaf[i] = LeafEntry(PhysAddr(phys.x + i * PAGE_SIZE), attr);
+    }
+}
+
+const LeafEntry page_entry(PhysAddr phys, Mode mode) {
+    return LeafEntry(phys, attributes<LeafEntry>(mode));
+}
+
+Mode page_mode(const LeafEntry entry) {
+    uint32_t attr = entry.raw() & ~LeafEntry::Addr::MASK;
+    for (int m = KERNEL_READ; m < MODE_UNKNOWN; ++m) {
+	if (page_entry(PhysAddr(0), Mode(m)).raw() == attr) {
+	    return Mode(m);
+	}
+    }
+    return MODE_UNKNOWN;
+}
+
+// write a single small page entry without any maintenance
+static void map_page(PhysAddr phys, const void * const virt, Mode mode) {
+    if (!kernel_pagetable[virt].is_table()) {
+	panic("%s(%#10.8X, %p, %s): no LeafTable", phys.x, virt, MODE_NAME[mode]);
+    }
+    LeafEntry & entry = kernel_leaftables[virt];
+    if (entry != LeafEntry::FAULT()) {
+	panic("%s(%#10.8X, %p, %s): double map", phys.x, virt, MODE_NAME[mode]);
+    }
+
+    entry = LeafEntry(phys, attributes<LeafEntry>(mode));
+}
+
+void map(PhysAddr phys, const void * const virt, Mode mode) {
+    map_range(phys, virt, PAGE_SIZE, mode);
+}
+
+// count LeafTable entries starting at virt are all unmapped
+static bool leaves_free(const char *virt, uint32_t count) {
+    const TableEntry &table = kernel_pagetable[virt];
+    if (table == TableEntry::FAULT()) {
+	return true;
+    }
+    if (!table.is_table()) {
+	return false;
+    }
+    const LeafEntry *entry = &kernel_leaftables[virt];
+    for (uint32_t i = 0; i < count; ++i) {
+	if (entry[i] != LeafEntry::FAULT()) {
+	    return false;
+	}
+    }
+    return true;
+}
+
+// bytes from virt to the end of the naturally aligned block of size align
+static inline size_t to_boundary(const char *virt, size_t align) {
+    return align - (uintptr_t(virt) & (align - 1));
+}
+
+void map_range(PhysAddr phys, const void * const virt, size_t size, Mode mode) {
+    IRQ::Guard guard;
+    Locked locked(lock);
+    const char *v = (const char *)virt;
+    size_t total = size;
+    while (size > 0) {
+	uint32_t align = phys.x | uintptr_t(v);
+	uint32_t step;
+	if ((align & (SECTION_SIZE - 1)) == 0 && size >= SECTION_SIZE
+	    && leaves_free(v, SECTION_SIZE / PAGE_SIZE)) {
+	    // replace the empty LeafTable with a section
+	    SectionEntry entry(phys, attributes<SectionEntry>(mode));
+	    kernel_pagetable[v] = TableEntry(RAW, entry.raw());
+	    step = SECTION_SIZE;
+	} else if ((align & (LARGE_PAGE_SIZE - 1)) == 0
+		   && size >= LARGE_PAGE_SIZE
+		   && leaves_free(v, LARGE_PAGE_SIZE / PAGE_SIZE)) {
+	    ensure_leaf_table(v);
+	    set_large_page(v, LargePageEntry(phys,
+					     attributes<LargePageEntry>(mode)));
+	    step = LARGE_PAGE_SIZE;
+	} else {
+	    ensure_leaf_table(v);
+	    map_page(phys, v, mode);
+	    step = PAGE_SIZE;
+	}
+	phys.x += step;
+	v += step;
+	size = (size > step) ? size - step : 0;
+    }
+    sync_range((const char *)virt, total);
+}
+
+void unmap_range(const void * const virt, size_t size) {
+    IRQ::Guard guard;
+    Locked locked(lock);
+    const char *v = (const char *)virt;
+    size_t total = size;
+    while (size > 0) {
+	TableEntry &table = kernel_pagetable[v];
+	size_t step;
+	if (table.is_section()) {
+	    if ((uintptr_t(v) & (SECTION_SIZE - 1)) != 0
+		|| size < SECTION_SIZE) {
+		split_section(v);
+		continue;
+	    }
+	    // the LeafTable is reattached lazily when the MB is used again
+	    table = TableEntry::FAULT();
+	    step = SECTION_SIZE;
+	} else if (table.is_table()) {
+	    LeafEntry &entry = kernel_leaftables[v];
+	    if (entry.is_large()) {
+		if ((uintptr_t(v) & (LARGE_PAGE_SIZE - 1)) != 0
+		    || size < LARGE_PAGE_SIZE) {
+		    split_large_page(v);
+		    continue;
+		}
+		set_large_page(v, LargePageEntry::FAULT());
+		step = LARGE_PAGE_SIZE;
+	    } else {
+		entry = LeafEntry::FAULT();
+		step = PAGE_SIZE;
+	    }
+	} else {
+	    // nothing mapped in this MB
+	    step = to_boundary(v, SECTION_SIZE);
+	}
+	v += step;
+	size = (size > step) ? size - step : 0;
+    }
+    sync_range((const char *)virt, total);
+}
+
+void protect_range(const void * const virt, size_t size, Mode mode) {
+    IRQ::Guard guard;
+    Locked locked(lock);
+    const char *v = (const char *)virt;
+    size_t total = size;
+    while (size > 0) {
+	TableEntry &table = kernel_pagetable[v];
+	size_t step;
+	if (table.is_section()) {
+	    if ((uintptr_t(v) & (SECTION_SIZE - 1)) != 0
+		|| size < SECTION_SIZE) {
+		split_section(v);
+		continue;
+	    }
+	    PhysAddr phys(table.raw() & SectionEntry::Addr::MASK);
+	    SectionEntry entry(phys, attributes<SectionEntry>(mode));
+	    table = TableEntry(RAW, entry.raw());
+	    step = SECTION_SIZE;
+	} else if (table.is_table()) {
+	    LeafEntry &entry = kernel_leaftables[v];
+	    if (entry.is_large()) {
+		if ((uintptr_t(v) & (LARGE_PAGE_SIZE - 1)) != 0
+		    || size < LARGE_PAGE_SIZE) {
+		    split_large_page(v);
+		    continue;
+		}
+		PhysAddr phys(entry.raw() & LargePageEntry::Addr::MASK);
+		set_large_page(v, LargePageEntry(phys,
+					attributes<LargePageEntry>(mode)));
+		step = LARGE_PAGE_SIZE;
+	    } else if (entry.is_small()) {
+		PhysAddr phys(entry.raw() & LeafEntry::Addr::MASK);
+		entry = LeafEntry(phys, attributes<LeafEntry>(mode));
+		step = PAGE_SIZE;
+	    } else {
+		panic("%s(%p, %#x, %s): not mapped", __FUNCTION__, v, size,
+		      MODE_NAME[mode]);
+		step = PAGE_SIZE;
+	    }
+	} else {
+	    panic("%s(%p, %#x, %s): not mapped", __FUNCTION__, v, size,
+		  MODE_NAME[mode]);
+	    step = to_boundary(v, SECTION_SIZE);
+	}
+	v += step;
+	size = (size > step) ? size - step : 0;
+    }
+    sync_range((const char *)virt, total);
+}
+
+PhysAddr walk_to_phys(const void * const virt) {
+    uintptr_t v = uintptr_t(virt);
+    if (v < USER_SPACE_END) return PhysAddr::NONE();
+    const TableEntry &table = kernel_pagetable[virt];
+    if (table.is_section()) {
+	return PhysAddr((table.raw() & SectionEntry::Addr::MASK)
+			| (v & (SECTION_SIZE - 1)));
+    }
+    if (!table.is_table()) return PhysAddr::NONE();
+    const LeafEntry &entry = kernel_leaftables[virt];
+    if (entry.is_large()) {
+	return PhysAddr((entry.raw() & LargePageEntry::Addr::MASK)
+			| (v & (LARGE_PAGE_SIZE - 1)));
+    }
+    if (entry.is_small()) {
+	return PhysAddr((entry.raw() & LeafEntry::Addr::MASK)
+			| (v & (PAGE_SIZE - 1)));
+    }
+    return PhysAddr::NONE();
+}
+
+size_t virt_to_phys_list(const void * const virt, size_t size,
+			 ScatterEntry *list, size_t max) {
+    const char *v = (const char *)virt;
+    size_t num = 0;
+    while (size > 0) {
+	PhysAddr phys = virt_to_phys(v);
+	if (!phys.valid()) return 0;
+	uint32_t step = to_boundary(v, PAGE_SIZE);
+	if (step > size) step = size;
+	if (num > 0 && list[num - 1].phys.x + list[num - 1].size == phys.x) {
+	    list[num - 1].size += step;
+	} else {
+	    if (num == max) return 0;
+	    list[num].phys = phys;
+	    list[num].size = step;
+	    ++num;
+	}
+	v += step;
+	size -= step;
+    }
+    return num;
 }
 
 __END_NAMESPACE(Memory);
@@ -21,6 +21,7 @@
 #ifndef KERNEL_MEMORY_PAGETABLE_H
 #define KERNEL_MEMORY_PAGETABLE_H 1
 
+#include <stddef.h>
 #include <sys/cdefs.h>
 
 __BEGIN_NAMESPACE(Kernel);
@@ -28,9 +29,18 @@ __BEGIN_NAMESPACE(Memory);
 
 struct PhysAddr;
 class TableEntry;
+class SectionEntry;
 class LeafEntry;
 
+enum {
+    PAGE_SHIFT = 12,
+    PAGE_SIZE  = 1U << PAGE_SHIFT,
+    LARGE_PAGE_SIZE = 1U << 16,
+    SECTION_SIZE = 1U << 20,
+};
+
 const TableEntry & table_entry(const void * const virt);
+const SectionEntry section_entry(const void * const virt);
 const LeafEntry & leaf_entry(const void * const virt);
 
 enum Mode {
@@ -41,10 +51,38 @@ enum Mode {
     FRAMEBUFFER,
     PERIPHERAL,
     KERNEL_PERIPHERAL,
+    COMMON_READ, // user read-only in every address space
+    COMMON_PERIPHERAL,
+    // attributes no Mode produces, e.g. the mappings made by boot.S
+    MODE_UNKNOWN,
 };
 
+const char * mode_name(Mode mode);
+
+// Mode of the attributes of a small page LeafEntry, may be MODE_UNKNOWN
+Mode page_mode(const LeafEntry entry);
+
+// small page LeafEntry for phys with the attributes for mode
+const LeafEntry page_entry(PhysAddr phys, Mode mode);
+
+// map a single page, same as map_range() with size PAGE_SIZE
 void map(PhysAddr phys, const void * const virt, Mode mode);
 
+/* map size bytes using the largest pages the alignment of phys and virt
+ * allows: 1M sections, 64k large pages or 4k small pages
+ * All range functions update every entry first and then do the cache and
+ * TLB maintenance for the whole range once.
+ */
+void map_range(PhysAddr phys, const void * const virt, size_t size, Mode mode);
+
+/* unmap size bytes starting at virt
+ * Sections and large pages only partially covered are split first.
+ */
+void unmap_range(const void * const virt, size_t size);
+
+// change the Mode of size already mapped bytes starting at virt
+void protect_range(const void * const virt, size_t size, Mode mode);
+
 __END_NAMESPACE(Memory);
 __END_NAMESPACE(Kernel);
 
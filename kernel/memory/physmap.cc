@@ -0,0 +1,181 @@
+/* Copyright (C) 2015 Goswin von Brederlow <goswin-v-b@web.de>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+/* Physical memory map
+ */
+
+#include "physmap.h"
+#include "pagetable.h"
+#include "arch_info.h"
+#include "fixed_addresses.h"
+#include "../assert.h"
+#include "../kprintf.h"
+#include "../init_priorities.h"
+
+__BEGIN_NAMESPACE(Kernel);
+__BEGIN_NAMESPACE(PhysMap);
+
+extern "C" {
+    // physical addresses from the linker script and boot.S
+    extern char _text_boot_start[];
+    extern char _end[];
+    extern char kernel_page_table[];
+    extern char boot_leaf_tables[];
+};
+
+enum {
+    MB_SHIFT = 20,
+    NUM_MBS = 1U << (32 - MB_SHIFT),
+};
+
+static Range ranges[MAX_RANGES];
+static uint32_t num_ranges;
+// first range not ending before the MB
+static uint8_t first_range[NUM_MBS];
+
+static const char *TYPE_NAME[] = {
+    "none", "usable", "kernel", "page tables", "initrd", "firmware",
+    "peripheral",
+};
+
+const char * type_name(MemType type) {
+    return TYPE_NAME[type];
+}
+
+static void build_index() {
+    uint32_t num = 0;
+    for (uint32_t mb = 0; mb < NUM_MBS; ++mb) {
+	while (num < num_ranges && ranges[num].end <= (mb << MB_SHIFT)) {
+	    ++num;
+	}
+	first_range[mb] = num;
+    }
+}
+
+void add(uint32_t start, uint32_t size, MemType type) {
+    uint32_t end = start + size;
+    assert(end >= start);
+    if (type == MEM_USABLE) {
+	start = (start + Memory::PAGE_SIZE - 1) & ~(Memory::PAGE_SIZE - 1);
+	end &= ~(Memory::PAGE_SIZE - 1);
+    } else {
+	start &= ~(Memory::PAGE_SIZE - 1);
+	end = (end + Memory::PAGE_SIZE - 1) & ~(Memory::PAGE_SIZE - 1);
+    }
+    if (start >= end) return;
+
+    // cut the new range out of the old ones and insert it in order
+    Range next[MAX_RANGES + 2];
+    uint32_t num = 0;
+    bool placed = false;
+    for (uint32_t i = 0; i < num_ranges; ++i) {
+	const Range &old = ranges[i];
+	if (old.end <= start || old.start >= end) {
+	    if (!placed && old.start >= end) {
+		next[num++] = Range{start, end, type};
+		placed = true;
+	    }
+	    next[num++] = old;
+	    continue;
+	}
+	if (old.start < start) {
+	    next[num++] = Range{old.start, start, old.type};
+	}
+	if (!placed) {
+	    next[num++] = Range{start, end, type};
+	    placed = true;
+	}
+	if (old.end > end) {
+	    next[num++] = Range{end, old.end, old.type};
+	}
+    }
+    if (!placed) {
+	next[num++] = Range{start, end, type};
+    }
+
+    // merge neighbours of the same type
+    num_ranges = 0;
+    for (uint32_t i = 0; i < num; ++i) {
+	if (num_ranges > 0) {
+	    Range &last = ranges[num_ranges - 1];
+	    if (last.end == next[i].start && last.type == next[i].type) {
+		last.end = next[i].end;
+		continue;
+	    }
+	}
+	assert(num_ranges < MAX_RANGES);
+	ranges[num_ranges++] = next[i];
+    }
+    build_index();
+}
+
+const Range * find(Memory::PhysAddr phys) {
+    uint32_t num = first_range[phys.x >> MB_SHIFT];
+    while (num < num_ranges && ranges[num].end <= phys.x) ++num;
+    if (num < num_ranges && ranges[num].start <= phys.x) {
+	return &ranges[num];
+    }
+    return nullptr;
+}
+
+uint32_t count() {
+    return num_ranges;
+}
+
+const Range & range(uint32_t num) {
+    return ranges[num];
+}
+
+uint32_t usable_end() {
+    for (uint32_t num = num_ranges; num > 0; --num) {
+	if (ranges[num - 1].type == MEM_USABLE) return ranges[num - 1].end;
+    }
+    return 0;
+}
+
+CONSTRUCTOR(PHYS_MAP) {
+    // ARCH_INFO added the RAM from the MEM tags, now claim the used parts
+    uint32_t kernel_start = uint32_t(_text_boot_start);
+    // ATAGs, command line and the spin tables of the other cores
+    add(0, kernel_start, MEM_FIRMWARE);
+    add(kernel_start, uint32_t(_end) - kernel_start, MEM_KERNEL);
+    add(uint32_t(kernel_page_table), 16384, MEM_PAGETABLES);
+    add(uint32_t(boot_leaf_tables), BOOT_LEAF_FRAMES * Memory::PAGE_SIZE,
+	MEM_PAGETABLES);
+    if (initrd_size > 0) {
+	add(initrd_start, initrd_size, MEM_INITRD);
+    }
+
+    // the VideoCore keeps the RAM between the ARM's and the peripherals
+    if (mem_total < peripheral_base) {
+	add(mem_total, peripheral_base - mem_total, MEM_FIRMWARE);
+    }
+    add(peripheral_base, PERIPHERAL_SIZE, MEM_PERIPHERAL);
+    if (model == RASPBERRY_PI_2) {
+	add(LOCAL_PERIPHERAL_BASE, LOCAL_PERIPHERAL_SIZE, MEM_PERIPHERAL);
+    }
+
+    kprintf("Physical memory map:\n");
+    for (uint32_t num = 0; num < num_ranges; ++num) {
+	const Range &r = ranges[num];
+	kprintf("  %#10.8lx - %#10.8lx %s\n", r.start, r.end - 1,
+		type_name(r.type));
+    }
+} CONSTRUCTOR_END
+
+__END_NAMESPACE(PhysMap);
+__END_NAMESPACE(Kernel);
@@ -0,0 +1,89 @@
+/* Copyright (C) 2015 Goswin von Brederlow <goswin-v-b@web.de>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+/* Physical memory map
+ *
+ * A sorted array of non-overlapping typed ranges covering everything known
+ * about the physical address space: the RAM from every MEM ATAG and the
+ * parts of it that are already in use, the VideoCore carve-out between the
+ * end of RAM and the peripherals, and the peripherals themselves. Addresses
+ * not covered by any range are holes.
+ *
+ * ARCH_INFO adds the RAM, PHYS_MAP reserves the kernel image, the boot page
+ * tables, the initrd and the firmware areas on top of it. A later add()
+ * replaces whatever the earlier ones said about its range. Reserved ranges
+ * are widened to whole pages, usable ones shrunk to whole pages.
+ *
+ * An index with one entry per MB points at the first range not ending
+ * before that MB, so a lookup only steps over the ranges ending inside the
+ * MB of the address.
+ */
+
+#ifndef KERNEL_MEMORY_PHYSMAP_H
+#define KERNEL_MEMORY_PHYSMAP_H 1
+
+#include <stdint.h>
+#include <sys/cdefs.h>
+#include "PhysAddr.h"
+
+__BEGIN_NAMESPACE(Kernel);
+__BEGIN_NAMESPACE(PhysMap);
+
+enum MemType {
+    MEM_NONE,       // hole, nothing there
+    MEM_USABLE,     // free RAM
+    MEM_KERNEL,     // kernel image and data structures placed after it
+    MEM_PAGETABLES, // page tables built by boot.S
+    MEM_INITRD,     // initial ramdisk loaded by the firmware
+    MEM_FIRMWARE,   // ATAGs, spin tables and the VideoCore carve-out
+    MEM_PERIPHERAL, // device registers
+};
+
+enum {
+    MAX_RANGES = 32,
+};
+
+struct Range {
+    uint32_t start;
+    uint32_t end; // exclusive
+    MemType type;
+};
+
+const char * type_name(MemType type);
+
+// mark [start, start + size) as type, replacing earlier entries
+void add(uint32_t start, uint32_t size, MemType type);
+
+// range containing phys or nullptr for a hole
+const Range * find(Memory::PhysAddr phys);
+
+static inline MemType type(Memory::PhysAddr phys) {
+    const Range *range = find(phys);
+    return range ? range->type : MEM_NONE;
+}
+
+// ranges in ascending order
+uint32_t count();
+const Range & range(uint32_t num);
+
+// end of the highest usable range, 0 when there is none
+uint32_t usable_end();
+
+__END_NAMESPACE(PhysMap);
+__END_NAMESPACE(Kernel);
+
+#endif // #ifndef KERNEL_MEMORY_PHYSMAP_H
@@ -0,0 +1,303 @@
+/* Copyright (C) 2015 Goswin von Brederlow <goswin-v-b@web.de>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+/* Kernel heap
+ */
+
+#include "slab.h"
+#include "frames.h"
+#include "pagetable.h"
+#include "../assert.h"
+#include "../core.h"
+#include "../irq.h"
+#include "../kprintf.h"
+#include "../init_priorities.h"
+#include "../spinlock.h"
+
+__BEGIN_NAMESPACE(Kernel);
+__BEGIN_NAMESPACE(Memory);
+
+// free objects are linked through their first word
+struct Object {
+    Object *next;
+};
+
+// header in the first cache line of every slab
+struct Slab {
+    Slab *next; // partial slabs of the same class
+    Slab *prev;
+    Object *free;
+    uint16_t inuse;
+    uint8_t cls;
+};
+
+struct SizeClass {
+    uint32_t size;
+    uint32_t order;    // a slab is 2^order pages
+    uint32_t per_slab; // objects per slab
+    uint32_t batch;    // objects moved between core cache and slabs
+    Slab *partial;     // slabs with free objects
+    uint32_t slabs;
+    uint32_t inuse;    // objects taken out of slabs, including core caches
+};
+
+// per core cache of free objects, lives in the COREn_PRIVATE window
+struct CoreCache {
+    Object *free[SLAB_CLASSES];
+    uint32_t count[SLAB_CLASSES];
+    uint32_t allocs[SLAB_CLASSES];
+    uint32_t frees[SLAB_CLASSES];
+    uint32_t large_allocs;
+    uint32_t large_frees;
+};
+
+static CoreCache & core_cache(uint32_t core) {
+    return *(CoreCache *)Core::private_addr(core, PRIVATE_SLAB);
+}
+
+// slabs, protected by lock
+static SpinLock lock;
+static SizeClass classes[SLAB_CLASSES];
+
+static uint32_t size_class(size_t size) {
+    if (size <= CACHE_LINE) return 0;
+    return 32 - __builtin_clz(size - 1) - SLAB_MIN_SHIFT;
+}
+
+static Slab * slab_of(const void *obj) {
+    uint32_t pfn = direct_to_phys(obj).x >> PAGE_SHIFT;
+    uint32_t mask = (PAGE_SIZE << page_info[pfn].order) - 1;
+    return (Slab *)(uintptr_t(obj) & ~mask);
+}
+
+static void partial_add(SizeClass &c, Slab *slab) {
+    slab->prev = nullptr;
+    slab->next = c.partial;
+    if (c.partial != nullptr) {
+	c.partial->prev = slab;
+    }
+    c.partial = slab;
+}
+
+static void partial_remove(SizeClass &c, Slab *slab) {
+    if (slab->prev == nullptr) {
+	c.partial = slab->next;
+    } else {
+	slab->prev->next = slab->next;
+    }
+    if (slab->next != nullptr) {
+	slab->next->prev = slab->prev;
+    }
+}
+
+static void set_slab_pages(Slab *slab, uint32_t order, bool is_slab) {
+    uint32_t pfn = direct_to_phys(slab).x >> PAGE_SHIFT;
+    for (uint32_t i = 0; i < (1U << order); ++i) {
+	page_info[pfn + i].slab = is_slab;
+	page_info[pfn + i].order = order;
+    }
+}
+
+static Slab * new_slab(uint32_t cls) {
+    SizeClass &c = classes[cls];
+    PhysAddr phys = alloc_frames(c.order);
+    if (!phys.valid()) return nullptr;
+
+    Slab *slab = (Slab *)phys_to_virt(phys);
+    set_slab_pages(slab, c.order, true);
+    slab->free = nullptr;
+    slab->inuse = 0;
+    slab->cls = cls;
+    // link objects so the lowest address is handed out first
+    char *first = (char *)slab + CACHE_LINE;
+    for (uint32_t i = c.per_slab; i-- > 0; ) {
+	Object *obj = (Object *)(first + i * c.size);
+	obj->next = slab->free;
+	slab->free = obj;
+    }
+    partial_add(c, slab);
+    ++c.slabs;
+    return slab;
+}
+
+// give an object back to its slab, lock must be held
+static void release_locked(Object *obj) {
+    Slab *slab = slab_of(obj);
+    SizeClass &c = classes[slab->cls];
+    if (slab->free == nullptr) {
+	partial_add(c, slab);
+    }
+    obj->next = slab->free;
+    slab->free = obj;
+    --slab->inuse;
+    --c.inuse;
+
+    // keep one empty slab around, free the rest
+    if (slab->inuse == 0 && (c.partial != slab || slab->next != nullptr)) {
+	partial_remove(c, slab);
+	set_slab_pages(slab, c.order, false);
+	--c.slabs;
+	free_frames(direct_to_phys(slab), c.order);
+    }
+}
+
+// move a batch of objects from the slabs into the core cache
+static void refill(CoreCache &cache, uint32_t cls) {
+    SizeClass &c = classes[cls];
+    Locked locked(lock);
+    while (cache.count[cls] < c.batch) {
+	Slab *slab = c.partial;
+	if (slab == nullptr) {
+	    slab = new_slab(cls);
+	    if (slab == nullptr) break;
+	}
+	Object *obj = slab->free;
+	slab->free = obj->next;
+	if (slab->free == nullptr) {
+	    partial_remove(c, slab);
+	}
+	++slab->inuse;
+	++c.inuse;
+	obj->next = cache.free[cls];
+	cache.free[cls] = obj;
+	++cache.count[cls];
+    }
+}
+
+// move a batch of objects from the core cache back to their slabs
+static void drain(CoreCache &cache, uint32_t cls) {
+    Locked locked(lock);
+    for (uint32_t i = 0; i < classes[cls].batch; ++i) {
+	Object *obj = cache.free[cls];
+	cache.free[cls] = obj->next;
+	--cache.count[cls];
+	release_locked(obj);
+    }
+}
+
+void * kmalloc(size_t size) {
+    IRQ::Guard guard;
+    CoreCache &cache = core_cache(Core::id());
+    if (size > SLAB_MAX_SIZE) {
+	uint32_t pages = (size + PAGE_SIZE - 1) >> PAGE_SHIFT;
+	uint32_t order = (pages == 1) ? 0 : 32 - __builtin_clz(pages - 1);
+	if (order >= MAX_ORDER) return nullptr;
+	PhysAddr phys = alloc_frames(order);
+	if (!phys.valid()) return nullptr;
+	++cache.large_allocs;
+	return phys_to_virt(phys);
+    }
+
+    uint32_t cls = size_class(size);
+    if (cache.count[cls] == 0) {
+	refill(cache, cls);
+	if (cache.count[cls] == 0) return nullptr;
+    }
+    Object *obj = cache.free[cls];
+    cache.free[cls] = obj->next;
+    --cache.count[cls];
+    ++cache.allocs[cls];
+    return obj;
+}
+
+void kfree(void *ptr) {
+    if (ptr == nullptr) return;
+    IRQ::Guard guard;
+    CoreCache &cache = core_cache(Core::id());
+    PhysAddr phys = direct_to_phys(ptr);
+    const PageInfo &info = page_info[phys.x >> PAGE_SHIFT];
+    if (!info.slab) {
+	++cache.large_frees;
+	free_frames(phys, info.order);
+	return;
+    }
+
+    uint32_t cls = slab_of(ptr)->cls;
+    Object *obj = (Object *)ptr;
+    obj->next = cache.free[cls];
+    cache.free[cls] = obj;
+    ++cache.frees[cls];
+    if (++cache.count[cls] > 2 * classes[cls].batch) {
+	drain(cache, cls);
+    }
+}
+
+void slab_report() {
+    kprintf("size slabs objects  live cached    allocs     frees overhead\n");
+    Locked locked(lock);
+    for (uint32_t cls = 0; cls < SLAB_CLASSES; ++cls) {
+	const SizeClass &c = classes[cls];
+	uint32_t cached = 0, allocs = 0, frees = 0;
+	for (uint32_t core = 0; core < Core::count(); ++core) {
+	    const CoreCache &cache = core_cache(core);
+	    cached += cache.count[cls];
+	    allocs += cache.allocs[cls];
+	    frees += cache.frees[cls];
+	}
+	uint32_t live = c.inuse - cached;
+	uint32_t reserved = c.slabs * (PAGE_SIZE << c.order);
+	uint32_t overhead = 0;
+	if (reserved > 0) {
+	    overhead = (reserved - live * c.size) * 100 / reserved;
+	}
+	kprintf("%4lu %5lu %7lu %5lu %6lu %9lu %9lu %7lu%%\n",
+		c.size, c.slabs, c.slabs * c.per_slab, live, cached,
+		allocs, frees, overhead);
+    }
+    uint32_t large_allocs = 0, large_frees = 0;
+    for (uint32_t core = 0; core < Core::count(); ++core) {
+	large_allocs += core_cache(core).large_allocs;
+	large_frees += core_cache(core).large_frees;
+    }
+    kprintf("large allocs %lu, frees %lu\n", large_allocs, large_frees);
+}
+
+CONSTRUCTOR(SLAB) {
+    for (uint32_t cls = 0; cls < SLAB_CLASSES; ++cls) {
+	SizeClass &c = classes[cls];
+	c.size = CACHE_LINE << cls;
+	// smallest slab that wastes at most 1/8th on header and tail
+	for (c.order = 0; ; ++c.order) {
+	    uint32_t slab_size = PAGE_SIZE << c.order;
+	    c.per_slab = (slab_size - CACHE_LINE) / c.size;
+	    if ((slab_size - c.per_slab * c.size) * 8 <= slab_size) break;
+	}
+	c.batch = (c.per_slab < 16) ? c.per_slab : 16;
+	c.partial = nullptr;
+	c.slabs = 0;
+	c.inuse = 0;
+    }
+
+    // map an object cache into the private window of every core
+    for (uint32_t core = 0; core < Core::count(); ++core) {
+	PhysAddr phys = alloc_frame();
+	assert(phys.valid());
+	map(phys, Core::private_addr(core, PRIVATE_SLAB), KERNEL_WRITE);
+	CoreCache &cache = core_cache(core);
+	for (uint32_t cls = 0; cls < SLAB_CLASSES; ++cls) {
+	    cache.free[cls] = nullptr;
+	    cache.count[cls] = 0;
+	    cache.allocs[cls] = 0;
+	    cache.frees[cls] = 0;
+	}
+	cache.large_allocs = 0;
+	cache.large_frees = 0;
+    }
+} CONSTRUCTOR_END
+
+__END_NAMESPACE(Memory);
+__END_NAMESPACE(Kernel);
@@ -0,0 +1,77 @@
+/* Copyright (C) 2015 Goswin von Brederlow <goswin-v-b@web.de>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+/* Kernel heap
+ *
+ * Small objects come from slabs of one size class each. Sizes are rounded
+ * up to a power of two of at least one cache line and every object is
+ * cache line aligned. Each core caches free objects of every class in its
+ * COREn_PRIVATE window and only goes to the slabs, under a lock, to refill
+ * or drain a batch. Objects larger than the biggest class get whole pages.
+ */
+
+#ifndef KERNEL_MEMORY_SLAB_H
+#define KERNEL_MEMORY_SLAB_H 1
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/cdefs.h>
+
+// placement new
+inline void * operator new(size_t, void *p) noexcept { return p; }
+
+__BEGIN_NAMESPACE(Kernel);
+__BEGIN_NAMESPACE(Memory);
+
+enum {
+    CACHE_LINE = 64,         // largest cache line of all supported cores
+    SLAB_MIN_SHIFT = 6,      // smallest size class is one cache line
+    SLAB_CLASSES = 6,        // 64, 128, 256, 512, 1024 and 2048 bytes
+    SLAB_MAX_SIZE = CACHE_LINE << (SLAB_CLASSES - 1),
+};
+
+/* allocate size bytes, cache line aligned
+ * Returns nullptr when out of memory.
+ */
+void * kmalloc(size_t size) __attribute__((malloc));
+
+// free memory from kmalloc(), kfree(nullptr) does nothing
+void kfree(void *ptr);
+
+// print allocation counters and memory overhead of every size class
+void slab_report();
+
+// allocate an object and construct it in place
+template<typename T, typename ... Args>
+T * create(Args ... args) {
+    void *mem = kmalloc(sizeof(T));
+    if (mem == nullptr) return nullptr;
+    return new(mem) T(args ...);
+}
+
+// destruct an object from create() and free it
+template<typename T>
+void destroy(T *obj) {
+    if (obj == nullptr) return;
+    obj->~T();
+    kfree(obj);
+}
+
+__END_NAMESPACE(Memory);
+__END_NAMESPACE(Kernel);
+
+#endif // #ifndef KERNEL_MEMORY_SLAB_H
@@ -0,0 +1,208 @@
+/* Copyright (C) 2015 Goswin von Brederlow <goswin-v-b@web.de>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+/* TLB maintenance
+ */
+
+#include "tlb.h"
+#include "asm.h"
+#include "arch_info.h"
+#include "../core.h"
+#include "../irq.h"
+
+__BEGIN_NAMESPACE(Kernel);
+__BEGIN_NAMESPACE(TLB);
+
+enum {
+    PAGE_MASK = 0xFFF,
+    ASID_MASK = 0xFF,
+};
+
+// innermost Batch of every core
+static Batch *active[Core::MAX_CORES];
+
+static inline bool broadcast() {
+    return model == RASPBERRY_PI_2;
+}
+
+// TLBIMVA / TLBIMVAIS
+static inline void op_mva(uint32_t mva) {
+    if (broadcast()) {
+	asm volatile ("mcr p15, 0, %0, c8, c3, 1" : : "r"(mva) : "memory");
+    } else {
+	asm volatile ("mcr p15, 0, %0, c8, c7, 1" : : "r"(mva) : "memory");
+    }
+}
+
+// TLBIASID / TLBIASIDIS
+static inline void op_asid(uint32_t asid) {
+    if (broadcast()) {
+	asm volatile ("mcr p15, 0, %0, c8, c3, 2" : : "r"(asid) : "memory");
+    } else {
+	asm volatile ("mcr p15, 0, %0, c8, c7, 2" : : "r"(asid) : "memory");
+    }
+}
+
+// TLBIALL / TLBIALLIS
+static inline void op_all() {
+    if (broadcast()) {
+	asm volatile ("mcr p15, 0, %0, c8, c3, 0" : : "r"(0) : "memory");
+    } else {
+	asm volatile ("mcr p15, 0, %0, c8, c7, 0" : : "r"(0) : "memory");
+    }
+}
+
+// BPIALL / BPIALLIS, entries may predict through the old mapping
+static inline void op_branch_predictor() {
+    if (broadcast()) {
+	asm volatile ("mcr p15, 0, %0, c7, c1, 6" : : "r"(0) : "memory");
+    } else {
+	asm volatile ("mcr p15, 0, %0, c7, c5, 6" : : "r"(0) : "memory");
+    }
+}
+
+static inline void finish() {
+    op_branch_predictor();
+    dsb();
+    isb();
+}
+
+static inline uint32_t mva(const void *virt, uint32_t asid) {
+    return (uintptr_t(virt) & ~uint32_t(PAGE_MASK)) | (asid & ASID_MASK);
+}
+
+void invalidate_page(const void *virt, uint32_t asid) {
+    IRQ::Guard guard;
+    Batch *batch = active[Core::id()];
+    if (batch != nullptr) {
+	batch->add(mva(virt, asid));
+	return;
+    }
+    dsb();
+    op_mva(mva(virt, asid));
+    finish();
+}
+
+void invalidate_range(const void *virt, size_t size, uint32_t asid) {
+    if (size == 0) return;
+    uint32_t first = uintptr_t(virt) >> 12;
+    uint32_t last = (uintptr_t(virt) + size - 1) >> 12;
+    if (last - first >= BATCH_PAGES) {
+	invalidate_all();
+	return;
+    }
+    IRQ::Guard guard;
+    Batch *batch = active[Core::id()];
+    if (batch != nullptr) {
+	for (uint32_t page = first; page <= last; ++page) {
+	    batch->add(mva((const void *)(page << 12), asid));
+	}
+	return;
+    }
+    dsb();
+    for (uint32_t page = first; page <= last; ++page) {
+	op_mva(mva((const void *)(page << 12), asid));
+    }
+    finish();
+}
+
+void invalidate_asid(uint32_t asid) {
+    IRQ::Guard guard;
+    Batch *batch = active[Core::id()];
+    if (batch != nullptr) {
+	batch->add_asid(asid & ASID_MASK);
+	return;
+    }
+    dsb();
+    op_asid(asid & ASID_MASK);
+    finish();
+}
+
+void invalidate_all() {
+    IRQ::Guard guard;
+    Batch *batch = active[Core::id()];
+    if (batch != nullptr) {
+	batch->all_ = true;
+	return;
+    }
+    dsb();
+    op_all();
+    finish();
+}
+
+Batch::Batch() : count_(0), num_asids_(0), all_(false) {
+    IRQ::Guard guard;
+    Batch *&top = active[Core::id()];
+    outer_ = top;
+    top = this;
+}
+
+Batch::~Batch() {
+    IRQ::Guard guard;
+    active[Core::id()] = outer_;
+    flush();
+}
+
+void Batch::add(uint32_t mva) {
+    if (all_) return;
+    if (count_ == BATCH_PAGES) {
+	all_ = true;
+	return;
+    }
+    mva_[count_++] = mva;
+}
+
+void Batch::add_asid(uint32_t asid) {
+    if (num_asids_ == BATCH_ASIDS) {
+	all_ = true;
+	return;
+    }
+    asids_[num_asids_++] = asid;
+}
+
+// hand the queue to the enclosing Batch or do it
+void Batch::flush() {
+    if (outer_ != nullptr) {
+	if (all_) {
+	    outer_->all_ = true;
+	    return;
+	}
+	for (uint32_t i = 0; i < count_; ++i) {
+	    outer_->add(mva_[i]);
+	}
+	for (uint32_t i = 0; i < num_asids_; ++i) {
+	    outer_->add_asid(asids_[i]);
+	}
+	return;
+    }
+    if (!all_ && count_ == 0 && num_asids_ == 0) return;
+    dsb();
+    if (all_) {
+	op_all();
+    } else {
+	for (uint32_t i = 0; i < num_asids_; ++i) {
+	    op_asid(asids_[i]);
+	}
+	for (uint32_t i = 0; i < count_; ++i) {
+	    op_mva(mva_[i]);
+	}
+    }
+    finish();
+}
+
+__END_NAMESPACE(TLB);
+__END_NAMESPACE(Kernel);
@@ -0,0 +1,97 @@
+/* Copyright (C) 2015 Goswin von Brederlow <goswin-v-b@web.de>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+/* TLB maintenance
+ *
+ * On the Raspberry Pi 2 all operations use the inner shareable forms, so
+ * they reach the TLBs of all cores. The ARM1176 of the Raspberry Pi only
+ * has the local operations.
+ *
+ * Every invalidate is complete when it returns: it orders earlier page
+ * table writes with a DSB before and finishes with branch predictor
+ * invalidate, DSB and ISB. While a Batch is alive on the core the
+ * invalidations are only queued and all of them share one such sequence
+ * when the Batch ends. A Batch escalates to a full flush when more pages
+ * are queued than invalidating one by one is worth. Page table changes
+ * made inside a Batch are only guaranteed to be used after it ended.
+ *
+ *     {
+ *         TLB::Batch batch;
+ *         Memory::map(...);
+ *         Memory::map(...);
+ *     } // one DSB, the queued invalidates, one DSB + ISB
+ */
+
+#ifndef KERNEL_MEMORY_TLB_H
+#define KERNEL_MEMORY_TLB_H 1
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/cdefs.h>
+
+__BEGIN_NAMESPACE(Kernel);
+__BEGIN_NAMESPACE(TLB);
+
+enum {
+    // invalidating more pages than this one by one is slower than a flush
+    BATCH_PAGES = 64,
+    BATCH_ASIDS = 8,
+};
+
+// entry for the page containing virt, for global entries asid is ignored
+void invalidate_page(const void *virt, uint32_t asid);
+
+// all pages of [virt, virt + size), a full flush when there are many
+void invalidate_range(const void *virt, size_t size, uint32_t asid);
+
+// all non-global entries of one address space
+void invalidate_asid(uint32_t asid);
+
+// everything, global or not
+void invalidate_all();
+
+// queue invalidations on this core for the lifetime of the object
+class Batch {
+public:
+    Batch();
+    ~Batch();
+
+    Batch(const Batch &) = delete;
+    Batch & operator =(const Batch &) = delete;
+private:
+    friend void invalidate_page(const void *virt, uint32_t asid);
+    friend void invalidate_range(const void *virt, size_t size,
+				 uint32_t asid);
+    friend void invalidate_asid(uint32_t asid);
+    friend void invalidate_all();
+
+    void add(uint32_t mva);
+    void add_asid(uint32_t asid);
+    void flush();
+
+    Batch *outer_;             // Batch active before this one
+    uint32_t count_;           // queued MVA | ASID values
+    uint32_t mva_[BATCH_PAGES];
+    uint32_t asids_[BATCH_ASIDS]; // queued per ASID invalidates
+    uint32_t num_asids_;
+    bool all_;                 // queue overflowed, flush everything
+};
+
+__END_NAMESPACE(TLB);
+__END_NAMESPACE(Kernel);
+
+#endif // #ifndef KERNEL_MEMORY_TLB_H
@@ -0,0 +1,78 @@
+/* Copyright (C) 2015 Goswin von Brederlow <goswin-v-b@web.de>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+/* Virtual to physical translation
+ *
+ * virt_to_phys() asks the MMU (ATS1CPR), which costs a few cycles and sees
+ * the same mappings as a load would, including user pages of the running
+ * address space. Only when the MMU reports a fault are the kernel tables
+ * walked in software, so pages mapped inside a TLB::Batch are found too.
+ * Pages unmapped or remapped inside a Batch are not: until the Batch is
+ * flushed the MMU may still translate them through a stale TLB entry. While
+ * a Batch is open use walk_to_phys(), which only reads the tables.
+ */
+
+#ifndef KERNEL_MEMORY_TRANSLATE_H
+#define KERNEL_MEMORY_TRANSLATE_H 1
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/cdefs.h>
+#include "PhysAddr.h"
+#include "mmu.h"
+
+__BEGIN_NAMESPACE(Kernel);
+__BEGIN_NAMESPACE(Memory);
+
+enum {
+    PAR_ABORT = 1U << 0,
+    PAR_PAGE_MASK = 0xFFFFF000,
+};
+
+/* physical address of virt from the kernel tables (TTBR1)
+ * Handles sections, large and small pages. Returns PhysAddr::NONE() when
+ * virt is not mapped or below USER_SPACE_END.
+ */
+PhysAddr walk_to_phys(const void * const virt);
+
+// physical address of virt or PhysAddr::NONE() when not mapped
+static inline PhysAddr virt_to_phys(const void * const virt) {
+    uint32_t par = translate_kernel_read(virt);
+    if (__builtin_expect(par & PAR_ABORT, 0)) {
+	return walk_to_phys(virt);
+    }
+    return PhysAddr((par & PAR_PAGE_MASK) | (uintptr_t(virt) & ~PAR_PAGE_MASK));
+}
+
+// physically contiguous part of a buffer
+struct ScatterEntry {
+    PhysAddr phys;
+    uint32_t size;
+};
+
+/* translate [virt, virt + size) into at most max physically contiguous
+ * runs, merging adjacent pages
+ * Returns the number of entries filled or 0 when part of the buffer is not
+ * mapped or does not fit into max entries.
+ */
+size_t virt_to_phys_list(const void * const virt, size_t size,
+			 ScatterEntry *list, size_t max);
+
+__END_NAMESPACE(Memory);
+__END_NAMESPACE(Kernel);
+
+#endif // #ifndef KERNEL_MEMORY_TRANSLATE_H
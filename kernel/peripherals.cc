@@ -0,0 +1,94 @@
+/* Copyright (C) 2015 Goswin von Brederlow <goswin-v-b@web.de>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+/* Peripheral windows and device registry
+ */
+
+#include "peripherals.h"
+#include "arch_info.h"
+#include "kprintf.h"
+#include "memory/pagetable.h"
+#include "memory/PhysAddr.h"
+#include "memory/tlb.h"
+
+__BEGIN_NAMESPACE(Peripheral);
+
+struct Device {
+    Base base;
+    const char *name;
+};
+
+static const Device DEVICES[] = {
+    {TIMER_BASE, "system timer"},
+    {IRQ_BASE,   "irq controller"},
+    {VC_BASE,    "vc mail boxes"},
+    {GPIO_BASE,  "gpio"},
+    {UART0_BASE, "uart0"},
+    {CORE_BASE,  "core mail boxes"},
+};
+
+static const Device * find(Base base) {
+    for (const Device &dev : DEVICES) {
+	if (dev.base == base) return &dev;
+    }
+    return NULL;
+}
+
+static bool is_local(Base base) {
+    return uintptr_t(base) >= KERNEL_LOCAL_PERIPHERALS;
+}
+
+void map_windows() {
+    using namespace Kernel;
+    TLB::Batch batch;
+    // 16 device sections, no LeafTable needed
+    Memory::map_range(Memory::PhysAddr(peripheral_base),
+		      (const void *)KERNEL_PERIPHERALS, PERIPHERAL_SIZE,
+		      Memory::KERNEL_PERIPHERAL);
+    if (model == RASPBERRY_PI_2) {
+	// one section, only the first 256k decode
+	Memory::map_range(Memory::PhysAddr(LOCAL_PERIPHERAL_BASE),
+			  (const void *)KERNEL_LOCAL_PERIPHERALS,
+			  Memory::SECTION_SIZE, Memory::KERNEL_PERIPHERAL);
+    }
+}
+
+uint32_t phys(Base base) {
+    if (is_local(base)) {
+	return Kernel::LOCAL_PERIPHERAL_BASE
+	    + (uintptr_t(base) - KERNEL_LOCAL_PERIPHERALS);
+    }
+    return Kernel::peripheral_base + (uintptr_t(base) - KERNEL_PERIPHERALS);
+}
+
+const char * name(Base base) {
+    const Device *dev = find(base);
+    return dev ? dev->name : "unknown";
+}
+
+void report() {
+    kprintf("Peripherals :\n");
+    for (const Device &dev : DEVICES) {
+	if (is_local(dev.base) && Kernel::model != Kernel::RASPBERRY_PI_2) {
+	    continue;
+	}
+	kprintf("  %#10.8lx at %#10.8lx %s\n", phys(dev.base),
+		uint32_t(dev.base), dev.name);
+    }
+}
+
+__END_NAMESPACE(Peripheral);
@@ -23,6 +23,7 @@
 
 #include <sys/cdefs.h>
 #include <stddef.h>
+#include <stdint.h>
 #include "asm.h"
 #include "fixed_addresses.h"
 
@@ -38,6 +39,32 @@ enum Base {
     VC_BASE    = KERNEL_VC_MAIL,
 };
 
+/* Registry of the devices in the peripheral windows
+ *
+ * The whole peripheral block is mapped once with device sections, so every
+ * device already has an address and a driver only needs its Base. Drivers
+ * get their registers through registers() instead of computing addresses
+ * from KERNEL_* constants.
+ */
+
+// map the peripheral windows, done by ARCH_INFO before any driver runs
+void map_windows();
+
+// typed pointer to the register at byte offset reg of a device
+template<typename Reg = uint32_t>
+static inline volatile Reg * registers(Base base, uint32_t reg = 0) {
+    return (volatile Reg *)(uintptr_t(base) + reg);
+}
+
+// physical address of a device, e.g. for DMA
+uint32_t phys(Base base);
+
+// name of a device or "unknown"
+const char * name(Base base);
+
+// print all registered devices
+void report();
+
 /* Barrier protecting peripherals when switching between them
  *
  * A memory barrier is inserted when a Barrier is converted to another base by
@@ -0,0 +1,456 @@
+/* Copyright (C) 2015 Goswin von Brederlow <goswin-v-b@web.de>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+/* Preemptive thread scheduler
+ */
+
+#include "sched.h"
+#include <string.h>
+#include "assert.h"
+#include "clock.h"
+#include "core.h"
+#include "irq.h"
+#include "kprintf.h"
+#include "smp.h"
+#include "spinlock.h"
+#include "timer.h"
+#include "memory/kva.h"
+#include "memory/slab.h"
+
+__BEGIN_NAMESPACE(Kernel);
+__BEGIN_NAMESPACE(Sched);
+
+extern "C" {
+    // switch.S
+    void switch_context(uint32_t *save_sp, uint32_t load_sp,
+			volatile bool *on_cpu);
+    void thread_start(void);
+    EXPORT void thread_entry(Thread::Entry entry, void *arg);
+};
+
+// registers switch_context() pops, the initial frame of a new thread
+struct SwitchFrame {
+#ifdef __ARM_NEON__
+    uint64_t d[32];
+    uint32_t fpscr;
+    uint32_t pad;
+#endif
+    uint32_t r4, r5, r6, r7, r8, r9, r10, r11, r12;
+    uint32_t lr;
+};
+
+/* one queue per priority and a bit for every non-empty queue
+ * The queues are circular lists without a head, heads_ points at the
+ * thread to run next.
+ */
+class RunQueue {
+public:
+    void push(Thread *thread) {
+	uint32_t prio = thread->priority_;
+	Thread *&head = heads_[prio];
+	if (head == nullptr) {
+	    head = thread;
+	    mask_ |= 1U << prio;
+	} else {
+	    thread->link_before<RunQueueList>(*head);
+	}
+	thread->state_ = READY;
+	++size_;
+    }
+
+    void remove(Thread *thread) {
+	uint32_t prio = thread->priority_;
+	Thread *&head = heads_[prio];
+	if (thread->alone<RunQueueList>()) {
+	    head = nullptr;
+	    mask_ &= ~(1U << prio);
+	} else {
+	    if (head == thread) head = &thread->next<RunQueueList>();
+	    thread->unlink<RunQueueList>();
+	}
+	--size_;
+    }
+
+    // highest priority with a runnable thread, -1 when all are empty
+    int top() const {
+	return (mask_ == 0) ? -1 : 31 - __builtin_clz(mask_);
+    }
+
+    /* best thread that can run here, self counts as runnable
+     * Skips threads whose registers another core is still saving and
+     * returns nullptr when only those are queued.
+     */
+    Thread * pop(Thread *self) {
+	uint32_t mask = mask_;
+	while (mask != 0) {
+	    uint32_t prio = 31 - __builtin_clz(mask);
+	    Thread *head = heads_[prio];
+	    Thread *thread = head;
+	    do {
+		if (thread == self || !thread->on_cpu_) {
+		    remove(thread);
+		    return thread;
+		}
+		thread = &thread->next<RunQueueList>();
+	    } while (thread != head);
+	    mask &= ~(1U << prio);
+	}
+	return nullptr;
+    }
+
+    // like pop() but the thread that would run last, for stealing
+    Thread * pop_last() {
+	uint32_t mask = mask_;
+	while (mask != 0) {
+	    uint32_t prio = 31 - __builtin_clz(mask);
+	    Thread *last = &heads_[prio]->prev<RunQueueList>();
+	    Thread *thread = last;
+	    do {
+		if (!thread->on_cpu_) {
+		    remove(thread);
+		    return thread;
+		}
+		thread = &thread->prev<RunQueueList>();
+	    } while (thread != last);
+	    mask &= ~(1U << prio);
+	}
+	return nullptr;
+    }
+
+    uint32_t size() const {
+	return size_;
+    }
+private:
+    uint32_t mask_;
+    uint32_t size_;
+    Thread *heads_[NUM_PRIORITIES];
+};
+
+/* every core owns a run queue
+ * The lock of a core is held across switch_context() and released by the
+ * thread switched to. A thread woken on another core is only picked once
+ * the core it ran on has saved its registers and cleared on_cpu_. Until
+ * then it is skipped, never waited for, so two cores picking each others
+ * outgoing thread can not block each other.
+ */
+struct CoreQueue {
+    SpinLock lock;
+    RunQueue queue;
+} __attribute__((aligned(Memory::CACHE_LINE)));
+
+// threads queued on a core, read without the lock to pick a victim
+struct LengthHint {
+    volatile uint32_t length;
+} __attribute__((aligned(Memory::CACHE_LINE)));
+
+static CoreQueue core_queue[Core::MAX_CORES];
+static LengthHint queue_length[Core::MAX_CORES];
+static Thread *current_thread[Core::MAX_CORES];
+// idle threads never enter a run queue, they are bound to their core
+static Thread *idle_thread[Core::MAX_CORES];
+// thread that exited and still runs on its stack until the next switch
+static Thread *dead_thread[Core::MAX_CORES];
+
+// time the idle thread of a core spent in WFI
+struct IdleStats {
+    volatile bool sleeping; // about to wait or waiting for an IRQ
+    uint32_t sleeps;
+    uint64_t time; // clock ticks
+    uint64_t since; // start() of the core
+} __attribute__((aligned(Memory::CACHE_LINE)));
+
+static IdleStats idle_stats[Core::MAX_CORES];
+
+// time slices only run while a thread other than idle runs
+static void start_slices(uint32_t core) {
+    if (core == 0) {
+	// the system timer IRQ only reaches core 0
+	Timer::start_slices(SLICE_USEC);
+    } else {
+	SMP::start_slices(SLICE_USEC);
+    }
+}
+
+static void stop_slices(uint32_t core) {
+    if (core == 0) {
+	Timer::stop_slices();
+    } else {
+	SMP::stop_slices();
+    }
+}
+
+Thread * current() {
+    IRQ::Guard guard;
+    return current_thread[Core::id()];
+}
+
+void reap() {
+    uint32_t core = Core::id();
+    Thread *thread = dead_thread[core];
+    if (thread == nullptr) return;
+    dead_thread[core] = nullptr;
+    KVA::free_stack(thread->stack_top_, THREAD_STACK_SIZE);
+    Memory::destroy(thread);
+}
+
+// second half of a switch, run by the thread switched to
+void finish_switch() {
+    core_queue[Core::id()].lock.unlock();
+    reap();
+}
+
+void thread_entry(Thread::Entry entry, void *arg) {
+    finish_switch();
+    IRQ::enable_irqs();
+    entry(arg);
+    exit();
+}
+
+/* take the thread that would run last from the core with the longest
+ * queue, the lock of core is held
+ * Returns nullptr when no other core has a queued thread or its lock is
+ * busy. Never waiting for the lock avoids a deadlock with a core stealing
+ * from us.
+ */
+static Thread * steal(uint32_t core) {
+    uint32_t victim = core;
+    uint32_t longest = 0;
+    for (uint32_t other = 0; other < Core::count(); ++other) {
+	uint32_t length = queue_length[other].length;
+	if (other != core && length > longest) {
+	    longest = length;
+	    victim = other;
+	}
+    }
+    if (longest == 0) return nullptr;
+
+    CoreQueue &from = core_queue[victim];
+    if (!from.lock.try_lock()) return nullptr;
+    Thread *thread = from.queue.pop_last();
+    queue_length[victim].length = from.queue.size();
+    from.lock.unlock();
+    return thread;
+}
+
+/* switch to the best runnable thread of this core, stealing one from
+ * another core when there is nothing but idle to run
+ * Called with IRQs disabled and the lock of the core held, returns with
+ * the lock released.
+ */
+void switch_locked() {
+    uint32_t core = Core::id();
+    CoreQueue &own = core_queue[core];
+    Thread *prev = current_thread[core];
+    Thread *idle = idle_thread[core];
+    Thread *next = nullptr;
+    if (prev->state_ == RUNNING && own.queue.top() < int(prev->priority_)) {
+	// nothing queued here beats prev, an idle core looks elsewhere
+	if (prev == idle) next = steal(core);
+	if (next == nullptr) {
+	    own.lock.unlock();
+	    return;
+	}
+    } else {
+	if (prev->state_ == RUNNING && prev != idle) own.queue.push(prev);
+	next = own.queue.pop(prev);
+	if (next == nullptr) next = steal(core);
+	if (next == nullptr) next = idle;
+	queue_length[core].length = own.queue.size();
+    }
+    next->state_ = RUNNING;
+    if (next == prev) {
+	own.lock.unlock();
+	return;
+    }
+    current_thread[core] = next;
+    if (prev == idle) {
+	idle_stats[core].sleeping = false;
+	start_slices(core);
+    }
+    // pop() only returns threads with on_cpu_ clear, read their stack after
+    dmb();
+    next->on_cpu_ = true;
+    switch_context(&prev->sp_, next->sp_, &prev->on_cpu_);
+    // running as prev again, maybe on another core
+    finish_switch();
+}
+
+// queue a thread on this core, true when it should preempt the caller
+static bool push_local(Thread *thread) {
+    uint32_t core = Core::id();
+    CoreQueue &own = core_queue[core];
+    {
+	Locked locked(own.lock);
+	own.queue.push(thread);
+	queue_length[core].length = own.queue.size();
+	Thread *running = current_thread[core];
+	if (running != nullptr && thread->priority() > running->priority()) {
+	    return true;
+	}
+    }
+    // let a sleeping core steal it, pairs with the dmb() in idle()
+    dmb();
+    for (uint32_t other = 0; other < Core::count(); ++other) {
+	if (other != core && idle_stats[other].sleeping) {
+	    SMP::kick(other);
+	    break;
+	}
+    }
+    return false;
+}
+
+Thread * create(const char *name, Thread::Entry entry, void *arg,
+		uint32_t priority) {
+    assert(priority < NUM_PRIORITIES);
+    Thread *thread = Memory::create<Thread>(name, priority);
+    if (thread == nullptr) return nullptr;
+    char *top = (char *)KVA::alloc_stack(THREAD_STACK_SIZE);
+    if (top == nullptr) {
+	Memory::destroy(thread);
+	return nullptr;
+    }
+    thread->stack_top_ = top;
+
+    // switch_context() returns into thread_start with entry and arg
+    SwitchFrame *frame = (SwitchFrame *)(top - sizeof(SwitchFrame));
+    memset(frame, 0, sizeof(SwitchFrame));
+    frame->r4 = uint32_t(entry);
+    frame->r5 = uint32_t(arg);
+    frame->lr = uint32_t(thread_start);
+    thread->sp_ = uint32_t(frame);
+
+    IRQ::Guard guard;
+    if (push_local(thread)) schedule();
+    return thread;
+}
+
+void start() {
+    Thread *idle = Memory::create<Thread>("idle", uint32_t(IDLE_PRIORITY));
+    assert(idle != nullptr);
+    idle->state_ = RUNNING;
+    idle->on_cpu_ = true;
+    uint32_t core = Core::id();
+    idle_thread[core] = idle;
+    current_thread[core] = idle;
+    idle_stats[core].since = Clock::ticks();
+}
+
+void idle() {
+    uint32_t core = Core::id();
+    assert(current_thread[core] == idle_thread[core]);
+    IdleStats &stats = idle_stats[core];
+    IRQ::disable_irqs();
+    while (true) {
+	// announce the sleep before the last look for work, a thread queued
+	// on another core after the look kicks this core out of the wfi
+	stats.sleeping = true;
+	dmb();
+	schedule();
+	// back from running other threads or a queued thread is still
+	// switching out on another core, look again
+	if (!stats.sleeping || queue_length[core].length > 0) continue;
+
+	// no tick, only the next timer event or a kick ends the sleep
+	stop_slices(core);
+	uint64_t start = Clock::ticks();
+	// a pending IRQ ends the wfi even while IRQs are disabled
+	asm volatile ("wfi");
+	stats.time += Clock::ticks() - start;
+	++stats.sleeps;
+	stats.sleeping = false;
+
+	// take the IRQ that ended the sleep
+	IRQ::enable_irqs();
+	IRQ::disable_irqs();
+    }
+}
+
+void idle_report() {
+    uint64_t now = Clock::ticks();
+    for (uint32_t core = 0; core < Core::count(); ++core) {
+	const IdleStats &stats = idle_stats[core];
+	if (idle_thread[core] == nullptr) continue;
+	uint64_t total = now - stats.since;
+	uint32_t permille = (total == 0) ? 0 : stats.time * 1000 / total;
+	kprintf("idle core %lu: %lu.%lu%% of %llu ms in %lu sleeps\n", core,
+		permille / 10, permille % 10, Clock::to_usec(total) / 1000,
+		stats.sleeps);
+    }
+}
+
+void schedule() {
+    core_queue[Core::id()].lock.lock();
+    switch_locked();
+}
+
+void yield() {
+    IRQ::Guard guard;
+    schedule();
+}
+
+void block() {
+    IRQ::Guard guard;
+    uint32_t core = Core::id();
+    Thread *thread = current_thread[core];
+    // idle must stay runnable
+    assert(thread != idle_thread[core]);
+    thread->waking_.lock();
+    if (thread->wakeup_) {
+	thread->wakeup_ = false;
+	thread->waking_.unlock();
+	return;
+    }
+    core_queue[core].lock.lock();
+    thread->state_ = BLOCKED;
+    thread->waking_.unlock();
+    switch_locked();
+}
+
+void wake(Thread *thread) {
+    IRQ::Guard guard;
+    bool preempt = false;
+    thread->waking_.lock();
+    if (thread->state_ == BLOCKED) {
+	// the waker queues the thread on its own core, where the data
+	// passed to the thread is still in the cache
+	preempt = push_local(thread);
+    } else {
+	thread->wakeup_ = true;
+    }
+    thread->waking_.unlock();
+    if (preempt) schedule();
+}
+
+void exit() {
+    IRQ::disable_irqs();
+    uint32_t core = Core::id();
+    assert(current_thread[core] != idle_thread[core]);
+    core_queue[core].lock.lock();
+    current_thread[core]->state_ = DEAD;
+    dead_thread[core] = current_thread[core];
+    switch_locked();
+    // not reached
+    while (true) { }
+}
+
+void tick() {
+    // IRQs are disabled in the handler
+    if (current_thread[Core::id()] != nullptr) schedule();
+}
+
+__END_NAMESPACE(Sched);
+__END_NAMESPACE(Kernel);
@@ -0,0 +1,142 @@
+/* Copyright (C) 2015 Goswin von Brederlow <goswin-v-b@web.de>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+/* Preemptive thread scheduler
+ *
+ * Runnable threads wait in one run queue per priority, 0 (idle) to 31.
+ * A bit per priority marks the non-empty queues, so the next thread is
+ * found with a single CLZ no matter how many threads exist. Threads of the
+ * same priority share the CPU round robin in slices driven by compare
+ * register 3 of the system timer on core 0 and the generic timer of the
+ * core on the others. Every core has its own run queues and a core
+ * without work steals from the core with the most queued threads.
+ *
+ * The idle loop is tickless: a core with nothing to run or steal stops
+ * its slices and sleeps in WFI until the next event of the timer wheel or
+ * a kick from a core that queued a thread.
+ *
+ * Threads run in SVC mode on their own stack. An IRQ saves the interrupted
+ * registers on that stack, so switching threads only has to exchange the
+ * callee saved registers and the stack pointer (switch.S). The thread that
+ * called start() becomes the idle thread of its core.
+ */
+
+#ifndef KERNEL_SCHED_H
+#define KERNEL_SCHED_H 1
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/cdefs.h>
+#include "list.h"
+#include "spinlock.h"
+
+__BEGIN_NAMESPACE(Kernel);
+__BEGIN_NAMESPACE(Sched);
+
+enum {
+    NUM_PRIORITIES = 32,
+    IDLE_PRIORITY = 0,
+    DEFAULT_PRIORITY = 16,
+    THREAD_STACK_SIZE = 16384,
+    SLICE_USEC = 10000, // round robin time slice
+};
+
+enum State {
+    READY,   // in a run queue
+    RUNNING, // current thread
+    BLOCKED, // waiting for wake()
+    DEAD,    // exited, freed by the next thread
+};
+
+class RunQueueList;
+
+class Thread : public Lists<Thread, RunQueueList> {
+public:
+    typedef void (*Entry)(void *arg);
+
+    Thread(const char *name, uint32_t priority)
+	: Lists<Thread, RunQueueList>(this), name_(name),
+	  priority_(priority), state_(BLOCKED), sp_(0), stack_top_(nullptr),
+	  on_cpu_(false), wakeup_(false) { }
+
+    const char * name() const { return name_; }
+    uint32_t priority() const { return priority_; }
+    State state() const { return state_; }
+private:
+    friend class RunQueue;
+    friend Thread * create(const char *name, Entry entry, void *arg,
+			   uint32_t priority);
+    friend void start();
+    friend void switch_locked();
+    friend void block();
+    friend void wake(Thread *thread);
+    friend void exit();
+    friend void reap();
+
+    Thread(const Thread &) = delete;
+    Thread & operator =(const Thread &) = delete;
+
+    const char *name_;
+    uint32_t priority_;
+    State state_;
+    uint32_t sp_; // saved stack pointer while not running
+    void *stack_top_; // from KVA::alloc_stack(), nullptr for the idle thread
+    volatile bool on_cpu_; // registers not saved yet, no core may pick it
+    bool wakeup_; // wake() while not blocked, the next block() returns
+    SpinLock waking_; // serializes block() and wake()
+};
+
+/* create a thread running entry(arg) and make it runnable
+ * Returns nullptr when out of memory.
+ */
+Thread * create(const char *name, Thread::Entry entry, void *arg,
+		uint32_t priority = DEFAULT_PRIORITY);
+
+// turn the caller into the idle thread of its core
+void start();
+
+// run the idle loop of this core, the caller must be its idle thread
+void idle() __attribute__((noreturn));
+
+// print the share of time each core slept in idle()
+void idle_report();
+
+// thread running on this core, nullptr before start()
+Thread * current();
+
+// give the CPU to the next thread of the same or higher priority
+void yield();
+
+// stop running until wake(), returns at once if woken since the last block
+void block();
+
+// make a blocked thread runnable, preempts the caller if it has priority
+void wake(Thread *thread);
+
+// end the current thread, its stack is freed by the next thread
+void exit() __attribute__((noreturn));
+
+// switch to the best runnable thread, IRQs must be disabled
+void schedule();
+
+// time slice expired, called from the timer IRQ
+void tick();
+
+__END_NAMESPACE(Sched);
+__END_NAMESPACE(Kernel);
+
+#endif // ##ifndef KERNEL_SCHED_H
@@ -0,0 +1,186 @@
+/* Copyright (C) 2015 Goswin von Brederlow <goswin-v-b@web.de>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+/* Secondary cores of the Raspberry Pi 2
+ */
+
+#include "smp.h"
+#include "asm.h"
+#include "clock.h"
+#include "core.h"
+#include "exceptions.h"
+#include "fixed_addresses.h"
+#include "irq.h"
+#include "kprintf.h"
+#include "sched.h"
+#include "timer.h"
+#include "memory/frames.h"
+#include "memory/pagetable.h"
+
+__BEGIN_NAMESPACE(Kernel);
+__BEGIN_NAMESPACE(SMP);
+
+enum CORE_Reg {
+    CORE_TIMER_CONTROL = 0x40, // 0x40000040 + 4 * core Timers IRQ control
+    CORE_MAILBOX_CONTROL = 0x50, // 0x40000050 + 4 * core Mailbox IRQ control
+    CORE_IRQ_SOURCE    = 0x60, // 0x40000060 + 4 * core IRQ source
+    CORE_MAILBOX_SET   = 0x80, // 0x40000080 + 16 * core + 4 * box write set
+    CORE_MAILBOX_CLEAR = 0xC0, // 0x400000C0 + 16 * core + 4 * box read clear
+};
+
+enum {
+    TIMER_CNTPNS = 1U << 1, // non-secure physical timer
+    KICK_MAILBOX = 0, // wakes an idle core
+    SOURCE_KICK = 1U << (4 + KICK_MAILBOX),
+    START_MAILBOX = 3, // the firmware polls this one
+    START_TIMEOUT_MSEC = 100,
+};
+
+template<Peripheral::Base>
+volatile uint32_t * CORE_reg(enum CORE_Reg reg, uint32_t offset) = delete;
+
+template<>
+volatile uint32_t * CORE_reg<Peripheral::CORE_BASE>(enum CORE_Reg reg,
+						   uint32_t offset) {
+    return Peripheral::registers(Peripheral::CORE_BASE, reg + offset);
+}
+
+extern "C" {
+    // physical entry point in boot.S
+    extern char _start_secondary[];
+    EXPORT void secondary_main(uint32_t core);
+};
+
+static volatile bool core_online[Core::MAX_CORES];
+// generic timer ticks per time slice of each core
+static uint32_t slice_ticks[Core::MAX_CORES];
+
+template<Peripheral::Base>
+void enable_kicks() = delete;
+
+template<>
+void enable_kicks<Peripheral::CORE_BASE>() {
+    BASE(CORE_BASE);
+    *CORE_reg<BASE>(CORE_MAILBOX_CONTROL, 4 * Core::id()) = 1U << KICK_MAILBOX;
+}
+
+static void set_timer(uint32_t ticks) {
+    // CNTP_TVAL, then enable CNTP_CTL
+    asm volatile ("mcr p15, 0, %0, c14, c2, 0" : : "r"(ticks));
+    asm volatile ("mcr p15, 0, %0, c14, c2, 1" : : "r"(1));
+}
+
+static bool map_stack(uintptr_t base) {
+    for (uintptr_t off = 0; off < CORE_STACK_SIZE; off += Memory::PAGE_SIZE) {
+	Memory::PhysAddr frame = Memory::alloc_frame();
+	if (!frame.valid()) return false;
+	Memory::map(frame, (const void *)(base + off), Memory::KERNEL_WRITE);
+    }
+    return true;
+}
+
+uint32_t online() {
+    uint32_t num = 0;
+    for (uint32_t core = 0; core < Core::MAX_CORES; ++core) {
+	if (core_online[core]) ++num;
+    }
+    return num;
+}
+
+template<>
+void start_secondaries<Peripheral::CORE_BASE>() {
+    BASE(CORE_BASE);
+    enable_kicks<BASE>();
+    core_online[Core::id()] = true;
+    const uintptr_t CORE_WINDOW = CORE1_PRIVATE - CORE0_PRIVATE;
+    for (uint32_t core = 1; core < Core::count(); ++core) {
+	uintptr_t window = core * CORE_WINDOW;
+	if (!map_stack(CORE0_SVC_STACK + window)
+	    || !map_stack(CORE0_SYS_STACK + window)
+	    || !map_stack(CORE0_ABORT_STACK + window)) {
+	    kprintf("SMP         : no memory for the stacks of core %lu\n",
+		    core);
+	    break;
+	}
+	*CORE_reg<BASE>(CORE_MAILBOX_SET, 16 * core + 4 * START_MAILBOX) =
+	    uint32_t(_start_secondary);
+    }
+    dsb();
+    asm volatile ("sev");
+
+    for (uint32_t msec = 0; msec < START_TIMEOUT_MSEC; ++msec) {
+	if (online() == Core::count()) break;
+	Timer::busy_wait(1000);
+    }
+    kprintf("SMP         : %lu of %lu cores online\n", online(),
+	    Core::count());
+}
+
+void secondary_main(uint32_t core) {
+    PERIPHERAL(CORE_BASE);
+    Exceptions::init_core();
+    Clock::init_core();
+    Sched::start();
+    enable_kicks<BASE>();
+    dmb();
+    core_online[core] = true;
+    Sched::idle();
+}
+
+template<>
+void start_slices<Peripheral::CORE_BASE>(uint32_t usec) {
+    BASE(CORE_BASE);
+    uint32_t core = Core::id();
+    uint32_t freq;
+    asm volatile ("mrc p15, 0, %0, c14, c0, 0" : "=r"(freq)); // CNTFRQ
+    slice_ticks[core] = freq / 1000 * usec / 1000;
+    set_timer(slice_ticks[core]);
+    *CORE_reg<BASE>(CORE_TIMER_CONTROL, 4 * core) = TIMER_CNTPNS;
+}
+
+template<>
+void stop_slices<Peripheral::CORE_BASE>() {
+    // CNTP_CTL
+    asm volatile ("mcr p15, 0, %0, c14, c2, 1" : : "r"(0));
+}
+
+template<>
+void kick<Peripheral::CORE_BASE>(uint32_t core) {
+    BASE(CORE_BASE);
+    *CORE_reg<BASE>(CORE_MAILBOX_SET, 16 * core + 4 * KICK_MAILBOX) = 1;
+}
+
+template<>
+bool handle_irq<Peripheral::CORE_BASE>() {
+    BASE(CORE_BASE);
+    uint32_t core = Core::id();
+    uint32_t source = *CORE_reg<BASE>(CORE_IRQ_SOURCE, 4 * core);
+    if ((source & SOURCE_KICK) != 0) {
+	// the kick only ends the wfi, the idle thread looks for work
+	*CORE_reg<BASE>(CORE_MAILBOX_CLEAR, 16 * core + 4 * KICK_MAILBOX) =
+	    ~0U;
+    }
+    if ((source & TIMER_CNTPNS) != 0) {
+	// writing TVAL also clears the IRQ
+	set_timer(slice_ticks[core]);
+	Sched::tick();
+    }
+    return (source & (SOURCE_KICK | TIMER_CNTPNS)) != 0;
+}
+
+__END_NAMESPACE(SMP);
+__END_NAMESPACE(Kernel);
@@ -0,0 +1,99 @@
+/* Copyright (C) 2015 Goswin von Brederlow <goswin-v-b@web.de>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+/* Secondary cores of the Raspberry Pi 2
+ *
+ * The firmware parks cores 1 to 3 in a loop polling their mailbox 3 in the
+ * per core peripheral block. start_secondaries() maps their stacks and
+ * writes the physical address of _start_secondary into those mailboxes.
+ * Each core then turns on its MMU with the kernel page table, installs the
+ * exception vectors, becomes the idle thread of the scheduler on that core
+ * and takes its time slices from its own generic timer.
+ *
+ * Mailbox 0 of each core kicks it out of the idle WFI when another core
+ * queued a thread it could steal.
+ */
+
+#ifndef KERNEL_SMP_H
+#define KERNEL_SMP_H 1
+
+#include <stdint.h>
+#include <sys/cdefs.h>
+#include "peripherals.h"
+
+__BEGIN_NAMESPACE(Kernel);
+__BEGIN_NAMESPACE(SMP);
+
+// release the other cores and wait for them to come up
+template<Peripheral::Base base = Peripheral::NONE>
+void start_secondaries() {
+    PERIPHERAL(CORE_BASE);
+    start_secondaries<BASE>();
+}
+
+template<>
+void start_secondaries<Peripheral::CORE_BASE>();
+
+// number of cores running the kernel
+uint32_t online();
+
+// time slices of usec micro seconds from the generic timer of this core
+template<Peripheral::Base base = Peripheral::NONE>
+void start_slices(uint32_t usec) {
+    PERIPHERAL(CORE_BASE);
+    start_slices<BASE>(usec);
+}
+
+template<>
+void start_slices<Peripheral::CORE_BASE>(uint32_t usec);
+
+// no more time slices on this core until the next start_slices()
+template<Peripheral::Base base = Peripheral::NONE>
+void stop_slices() {
+    PERIPHERAL(CORE_BASE);
+    stop_slices<BASE>();
+}
+
+template<>
+void stop_slices<Peripheral::CORE_BASE>();
+
+// raise an IRQ on core, waking it from the idle WFI
+template<Peripheral::Base base = Peripheral::NONE>
+void kick(uint32_t core) {
+    PERIPHERAL(CORE_BASE);
+    kick<BASE>(core);
+}
+
+template<>
+void kick<Peripheral::CORE_BASE>(uint32_t core);
+
+/* handle the core local IRQ sources, all of them on a secondary core
+ * Returns false when none was pending.
+ */
+template<Peripheral::Base base = Peripheral::NONE>
+bool handle_irq() {
+    PERIPHERAL(CORE_BASE);
+    return handle_irq<BASE>();
+}
+
+template<>
+bool handle_irq<Peripheral::CORE_BASE>();
+
+__END_NAMESPACE(SMP);
+__END_NAMESPACE(Kernel);
+
+#endif // ##ifndef KERNEL_SMP_H
@@ -0,0 +1,112 @@
+/* Copyright (C) 2015 Goswin von Brederlow <goswin-v-b@web.de>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+/* Ticket spin lock
+ *
+ * Cores take a ticket with ldrex/strex and wait with wfe until the owner
+ * count reaches their ticket, so waiters are served in order. The lock does
+ * not disable IRQs, combine it with IRQ::Guard when an IRQ handler might
+ * take the same lock.
+ */
+
+#ifndef KERNEL_SPINLOCK_H
+#define KERNEL_SPINLOCK_H 1
+
+#include <stdint.h>
+#include <sys/cdefs.h>
+#include "asm.h"
+
+__BEGIN_NAMESPACE(Kernel);
+
+class SpinLock {
+public:
+    constexpr SpinLock() : owner_(0), next_(0) { }
+
+    void lock() {
+	uint32_t old, tmp, fail;
+	asm volatile ("1:	ldrex	%[old], [%[lock]]\n"
+		      "	add	%[tmp], %[old], #0x10000\n"
+		      "	strex	%[fail], %[tmp], [%[lock]]\n"
+		      "	teq	%[fail], #0\n"
+		      "	bne	1b"
+		      : [old] "=&r" (old), [tmp] "=&r" (tmp),
+			[fail] "=&r" (fail)
+		      : [lock] "r" (&owner_)
+		      : "cc", "memory");
+	uint16_t ticket = old >> 16;
+	while (owner_ != ticket) {
+	    asm volatile ("wfe");
+	}
+	dmb();
+    }
+
+    // take the lock only if nobody holds or waits for it
+    bool try_lock() {
+	uint32_t old, tmp, fail;
+	asm volatile ("1:	ldrex	%[old], [%[lock]]\n"
+		      "	mov	%[fail], #1\n"
+		      "	teq	%[old], %[old], ror #16\n" // owner == next?
+		      "	bne	2f\n"
+		      "	add	%[tmp], %[old], #0x10000\n"
+		      "	strex	%[fail], %[tmp], [%[lock]]\n"
+		      "	teq	%[fail], #0\n"
+		      "	bne	1b\n"
+		      "2:"
+		      : [old] "=&r" (old), [tmp] "=&r" (tmp),
+			[fail] "=&r" (fail)
+		      : [lock] "r" (&owner_)
+		      : "cc", "memory");
+	if (fail != 0) return false;
+	dmb();
+	return true;
+    }
+
+    void unlock() {
+	dmb();
+	owner_ = owner_ + 1;
+	dsb();
+	asm volatile ("sev");
+    }
+
+    SpinLock(const SpinLock &) = delete;
+    SpinLock & operator =(const SpinLock &) = delete;
+private:
+    // owner_ must be the low half of the word for the ticket increment
+    volatile uint16_t owner_;
+    volatile uint16_t next_;
+} __attribute__((aligned(4)));
+
+// hold a SpinLock for the lifetime of the object
+class Locked {
+public:
+    explicit Locked(SpinLock &lock) : lock_(lock) {
+	lock_.lock();
+    }
+
+    ~Locked() {
+	lock_.unlock();
+    }
+
+    Locked(const Locked &) = delete;
+    Locked & operator =(const Locked &) = delete;
+private:
+    SpinLock &lock_;
+};
+
+__END_NAMESPACE(Kernel);
+
+#endif // ##ifndef KERNEL_SPINLOCK_H
@@ -24,6 +24,8 @@
 #include "irq.h"
 #include "led.h"
 #include "peripherals.h"
+#include "sched.h"
+#include "wheel.h"
 
 __BEGIN_NAMESPACE(Kernel);
 __BEGIN_NAMESPACE(Timer);
@@ -43,7 +45,7 @@ volatile uint32_t * TIMER_reg(enum TIMER_Reg reg) = delete;
 
 template<>
 volatile uint32_t * TIMER_reg<Peripheral::TIMER_BASE>(enum TIMER_Reg reg) {
-    return (volatile uint32_t *)(KERNEL_TIMER + reg);
+    return Peripheral::registers(Peripheral::TIMER_BASE, reg);
 }
 
 template<Peripheral::Base>
@@ -63,15 +65,24 @@ template<>
 void ctrl_set<Peripheral::TIMER_BASE>(uint32_t t) {
     BASE(TIMER_BASE);
     volatile uint32_t *ctrl = TIMER_reg<BASE>(TIMER_CS);
-    *ctrl |= t;
+    // bits are write 1 to clear, writing back the read value would clear
+    // the matches of the other channels too
+    *ctrl = t;
 }
 
 template<>
-uint64_t __attribute__((noinline)) count<Peripheral::TIMER_BASE>() {
+uint64_t count<Peripheral::TIMER_BASE>() {
     BASE(TIMER_BASE);
     volatile uint32_t *hi = TIMER_reg<BASE>(TIMER_CHI);
     volatile uint32_t *lo = TIMER_reg<BASE>(TIMER_CLO);
-    return (((uint64_t)*hi) << 32) | *lo;
+    // the low word may wrap between the loads, then hi changes too
+    uint32_t high = *hi;
+    while (true) {
+	uint32_t low = *lo;
+	uint32_t again = *hi;
+	if (again == high) return (uint64_t(high) << 32) | low;
+	high = again;
+    }
 }
 
 template<Peripheral::Base>
@@ -119,6 +130,41 @@ void busy_wait<Peripheral::TIMER_BASE>(uint32_t usec) {
     }
 }
 
+// print the time and blink the LEDs on every second mark
+static void second_mark(Event *event, void *arg) {
+    (void)arg;
+    uint64_t t = count();
+    uint32_t frac, seconds, minutes, hours;
+    frac = t % 1000000;
+    t /= 1000000;
+    seconds = t % 60;
+    t /= 60;
+    minutes = t % 60;
+    t /= 60;
+    hours = t;
+    kprintf("time = %lu:%02lu:%02lu.%06lu\n", hours, minutes, seconds, frac);
+    if (seconds % 10 == 0) Sched::idle_report();
+
+    // trigger on the next second mark
+    add(event, event->deadline() + 1000000);
+
+    // toggle leds
+    switch(seconds % 4) {
+    case 0:
+	LED::set(LED::LED_ACT, true);
+	break;
+    case 1:
+	LED::set(LED::LED_PWR, true);
+	break;
+    case 2:
+	LED::set(LED::LED_ACT, false);
+	break;
+    case 3:
+	LED::set(LED::LED_PWR, false);
+	break;
+    }
+}
+
 template<>
 void test<Peripheral::TIMER_BASE>() {
     BASE(TIMER_BASE);
@@ -130,64 +176,58 @@ void test<Peripheral::TIMER_BASE>() {
     kprintf("timer cmp 2 = %#10lx\n", cmp<BASE>(2));
     kprintf("timer cmp 3 = %#10lx\n", cmp<BASE>(3));
     kprintf("\n");
-    
+
     // trigger on the second next second (at least one second from now)
-    set_cmp<BASE>(1, t / 1000000 * 1000000 + 2000000);
-    
-    // clear pending bit and enable irq
-    ctrl_set<BASE>(1U << 1);
-    IRQ::enable_irq<BASE>(IRQ::IRQ_TIMER1);
-    IRQ::enable_irqs();
+    static Event mark(second_mark, nullptr);
+    add(&mark, t / 1000000 * 1000000 + 2000000);
 
-    while (1) {
-	// chill out
-	asm volatile ("wfi");
-    }
+    // chill out
+    Sched::idle();
 }
 
 template<>
-void handle_timer1<Peripheral::TIMER_BASE>() {
+void set_alarm<Peripheral::TIMER_BASE>(uint32_t when) {
     BASE(TIMER_BASE);
-    uint64_t t = count<BASE>();
-    kprintf("timer CS    = %lu\n", status<BASE>());
-    kprintf("timer count = %#18llx\n", t);
-    kprintf("timer cmp 0 = %#10lx\n", cmp<BASE>(0));
-    kprintf("timer cmp 1 = %#10lx\n", cmp<BASE>(1));
-    kprintf("timer cmp 2 = %#10lx\n", cmp<BASE>(2));
-    kprintf("timer cmp 3 = %#10lx\n", cmp<BASE>(3));
+    // clear a match of the previous value, a match before the new value
+    // lands only costs an empty pass of the wheel
+    ctrl_set<BASE>(1U << 1);
+    set_cmp<BASE>(1, when);
+}
 
-    uint32_t frac, seconds, minutes, hours, next;
-    frac = t % 1000000;
-    t /= 1000000;
-    next = t * 1000000 + 1000000;
-    seconds = t % 60;
-    t /= 60;
-    minutes = t % 60;
-    t /= 60;
-    hours = t;
-    kprintf("time = %lu:%02lu:%02lu.%06lu\n", hours, minutes, seconds, frac);
-    kprintf("\n");
-    
+template<>
+void handle_timer1<Peripheral::TIMER_BASE>() {
+    BASE(TIMER_BASE);
     // clear pending bit
     ctrl_set<BASE>(1U << 1);
-    // trigger one the next second mark
-    set_cmp<BASE>(1, next);
+    run_wheel();
+}
 
-    // toggle leds
-    switch(seconds % 4) {
-    case 0:
-	LED::set<BASE>(LED::LED_ACT, true);
-	break;
-    case 1:
-	LED::set<BASE>(LED::LED_PWR, true);
-	break;
-    case 2:
-	LED::set<BASE>(LED::LED_ACT, false);
-	break;
-    case 3:
-	LED::set<BASE>(LED::LED_PWR, false);
-	break;
-    }
+static uint32_t slice_usec;
+
+template<>
+void start_slices<Peripheral::TIMER_BASE>(uint32_t usec) {
+    BASE(TIMER_BASE);
+    slice_usec = usec;
+    set_cmp<BASE>(3, lowcount<BASE>() + usec);
+    // clear pending bit and enable irq
+    ctrl_set<BASE>(1U << 3);
+    IRQ::enable_irq<BASE>(IRQ::IRQ_TIMER3);
+}
+
+template<>
+void stop_slices<Peripheral::TIMER_BASE>() {
+    BASE(TIMER_BASE);
+    IRQ::disable_irq<BASE>(IRQ::IRQ_TIMER3);
+}
+
+template<>
+void handle_timer3<Peripheral::TIMER_BASE>() {
+    BASE(TIMER_BASE);
+    // clear pending bit and trigger again one slice after the last match,
+    // so slices do not drift by the IRQ latency
+    ctrl_set<BASE>(1U << 3);
+    set_cmp<BASE>(3, cmp<BASE>(3) + slice_usec);
+    Sched::tick();
 }
 
 __END_NAMESPACE(Timer);
@@ -55,6 +55,45 @@ void handle_timer1() {
 template<>
 void handle_timer1<Peripheral::TIMER_BASE>();
 
+// raise IRQ_TIMER1 when the low 32 bits of count() reach when
+template<Peripheral::Base base = Peripheral::NONE>
+void set_alarm(uint32_t when) {
+    PERIPHERAL(TIMER_BASE);
+    set_alarm<BASE>(when);
+}
+
+template<>
+void set_alarm<Peripheral::TIMER_BASE>(uint32_t when);
+
+// start a scheduler tick every usec micro seconds on compare 3
+template<Peripheral::Base base = Peripheral::NONE>
+void start_slices(uint32_t usec) {
+    PERIPHERAL(TIMER_BASE);
+    start_slices<BASE>(usec);
+}
+
+template<>
+void start_slices<Peripheral::TIMER_BASE>(uint32_t usec);
+
+// no more scheduler ticks until the next start_slices()
+template<Peripheral::Base base = Peripheral::NONE>
+void stop_slices() {
+    PERIPHERAL(TIMER_BASE);
+    stop_slices<BASE>();
+}
+
+template<>
+void stop_slices<Peripheral::TIMER_BASE>();
+
+template<Peripheral::Base base = Peripheral::NONE>
+void handle_timer3() {
+    PERIPHERAL(TIMER_BASE);
+    handle_timer3<BASE>();
+}
+
+template<>
+void handle_timer3<Peripheral::TIMER_BASE>();
+
 /* busily wait at least usec micro seconds
  * busy_wait(0) will wait till the next timer tick
  */
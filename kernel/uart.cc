@@ -55,7 +55,7 @@ volatile uint32_t *UART0_reg(enum UART0_Reg reg) = delete;
 
 template<>
 volatile uint32_t *UART0_reg<Peripheral::UART0_BASE>(enum UART0_Reg reg) {
-    return (volatile uint32_t *)(KERNEL_UART + reg);
+    return Peripheral::registers(Peripheral::UART0_BASE, reg);
 }
 
 enum {
@@ -0,0 +1,60 @@
+/* Copyright (C) 2015 Goswin von Brederlow <goswin-v-b@web.de>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+// test the timer wheel, run once at boot
+
+#include "wheel.h"
+#include "assert.h"
+#include "init_priorities.h"
+#include "timer.h"
+
+__BEGIN_NAMESPACE(Kernel);
+__BEGIN_NAMESPACE(Timer);
+
+static void count_call(Event *event, void *arg) {
+    (void)event;
+    ++*(uint32_t *)arg;
+}
+
+CONSTRUCTOR(TIMER_WHEEL_TEST) {
+    uint32_t due = 0, cancelled = 0, later = 0;
+    Event now(count_call, &due);
+    Event gone(count_call, &cancelled);
+    Event cascade(count_call, &later);
+    uint64_t t = count();
+    add(&now, t);
+    add(&gone, t);
+    // lands above level 0 and has to move down before it fires
+    add(&cascade, t + 2 * WHEEL_SLOTS * TICK_USEC);
+    assert(cancel(&gone));
+    assert(!cancel(&gone));
+
+    // IRQs are still disabled, run the wheel by hand
+    busy_wait(TICK_USEC);
+    run_wheel();
+    assert(due == 1 && !now.pending());
+    assert(cancelled == 0);
+    assert(later == 0 && cascade.pending());
+
+    busy_wait(2 * WHEEL_SLOTS * TICK_USEC);
+    run_wheel();
+    assert(later == 1 && !cascade.pending());
+    assert(due == 1);
+} CONSTRUCTOR_END
+
+__END_NAMESPACE(Timer);
+__END_NAMESPACE(Kernel);
@@ -0,0 +1,259 @@
+/* Copyright (C) 2015 Goswin von Brederlow <goswin-v-b@web.de>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+/* Timer wheel
+ */
+
+#include "wheel.h"
+#include "assert.h"
+#include "irq.h"
+#include "sched.h"
+#include "spinlock.h"
+#include "timer.h"
+#include "init_priorities.h"
+
+__BEGIN_NAMESPACE(Kernel);
+__BEGIN_NAMESPACE(Timer);
+
+enum {
+    MAX_DELTA = 1U << (WHEEL_LEVELS * WHEEL_BITS), // ticks
+    // the compare register only matches on equality, never program it
+    // closer to the counter than this
+    MIN_DELAY = 4, // micro seconds
+};
+
+/* the wheel proper, callers hold the lock
+ * now_ is the tick everything before has been expired for. A slot of
+ * level l is reached when now_ gets to the first tick of the slot. At
+ * level 0 that fires the events, above it moves them down a level.
+ */
+class Wheel {
+public:
+    void init(uint64_t tick) {
+	now_ = tick;
+    }
+
+    void add(Event *event, uint64_t deadline) {
+	if (event->pending()) remove(event);
+	event->deadline_ = deadline;
+	insert(event);
+    }
+
+    // call the callback of an expired event, without the lock
+    static void fire(Event *event) {
+	event->callback_(event, event->arg_);
+    }
+
+    void insert(Event *event) {
+	uint64_t tick = (event->deadline_ + TICK_USEC - 1) >> TICK_SHIFT;
+	if (tick < now_) tick = now_;
+	uint64_t delta = tick - now_;
+	if (delta >= MAX_DELTA) {
+	    // waits in the top level and goes round again
+	    delta = MAX_DELTA - 1;
+	    tick = now_ + delta;
+	}
+	uint32_t level = 0;
+	if (delta >= WHEEL_SLOTS) {
+	    level = (31 - __builtin_clz(uint32_t(delta))) / WHEEL_BITS;
+	}
+	uint32_t slot = (tick >> (level * WHEEL_BITS)) & (WHEEL_SLOTS - 1);
+	Event *&head = slots_[level][slot];
+	if (head == nullptr) {
+	    head = event;
+	    bitmap_[level] |= 1ULL << slot;
+	} else {
+	    event->link_before<WheelList>(*head);
+	}
+	event->slot_ = level * WHEEL_SLOTS + slot;
+    }
+
+    void remove(Event *event) {
+	uint32_t level = event->slot_ / WHEEL_SLOTS;
+	uint32_t slot = event->slot_ % WHEEL_SLOTS;
+	Event *&head = slots_[level][slot];
+	if (event->alone<WheelList>()) {
+	    head = nullptr;
+	    bitmap_[level] &= ~(1ULL << slot);
+	} else {
+	    if (head == event) head = &event->next<WheelList>();
+	    event->unlink<WheelList>();
+	}
+	event->slot_ = Event::NOT_PENDING;
+    }
+
+    /* next tick with something to do, ~0 when the wheel is empty
+     * A set slot after the current one of its level is reached in this
+     * round of the level. Any other slot is only reached in the next
+     * round, except the current slot of level 0, which is due now.
+     */
+    uint64_t next_tick() const {
+	uint64_t next = ~0ULL;
+	for (uint32_t level = 0; level < WHEEL_LEVELS; ++level) {
+	    uint64_t bits = bitmap_[level];
+	    if (bits == 0) continue;
+	    uint32_t shift = level * WHEEL_BITS;
+	    uint32_t index = (now_ >> shift) & (WHEEL_SLOTS - 1);
+	    uint64_t round = now_ >> (shift + WHEEL_BITS) << (shift + WHEEL_BITS);
+	    uint64_t first = (level == 0) ? index : index + 1;
+	    uint64_t ahead = (first < WHEEL_SLOTS) ? bits >> first << first : 0;
+	    uint64_t tick;
+	    if (ahead != 0) {
+		tick = round + (uint64_t(__builtin_ctzll(ahead)) << shift);
+	    } else {
+		tick = round + (uint64_t(WHEEL_SLOTS) << shift)
+		    + (uint64_t(__builtin_ctzll(bits)) << shift);
+	    }
+	    if (tick < next) next = tick;
+	}
+	return next;
+    }
+
+    /* advance to tick and take one expired event out of the wheel
+     * Returns nullptr when nothing expires up to tick.
+     */
+    Event * expire(uint64_t tick) {
+	while (true) {
+	    uint32_t index = now_ & (WHEEL_SLOTS - 1);
+	    if ((bitmap_[0] & (1ULL << index)) != 0) {
+		Event *event = slots_[0][index];
+		remove(event);
+		return event;
+	    }
+	    uint64_t next = next_tick();
+	    if (next > tick) {
+		if (tick > now_) now_ = tick;
+		return nullptr;
+	    }
+	    now_ = next;
+	    cascade();
+	}
+    }
+private:
+    // move the events of all slots starting at now_ down, top level first
+    void cascade() {
+	uint32_t top = 0;
+	while (top + 1 < WHEEL_LEVELS
+	       && (now_ & ((1ULL << ((top + 1) * WHEEL_BITS)) - 1)) == 0) {
+	    ++top;
+	}
+	for (uint32_t level = top; level > 0; --level) {
+	    uint32_t slot = (now_ >> (level * WHEEL_BITS)) & (WHEEL_SLOTS - 1);
+	    while (slots_[level][slot] != nullptr) {
+		Event *event = slots_[level][slot];
+		remove(event);
+		insert(event);
+	    }
+	}
+    }
+
+    uint64_t now_;
+    uint64_t bitmap_[WHEEL_LEVELS];
+    Event *slots_[WHEEL_LEVELS][WHEEL_SLOTS];
+};
+
+static SpinLock lock;
+static Wheel wheel;
+// tick compare 1 is set to, ~0 when not armed
+static uint64_t armed = ~0ULL;
+
+// set compare 1 for the next tick with work, lock held
+static void program() {
+    uint64_t next = wheel.next_tick();
+    if (next == armed) return;
+    armed = next;
+    if (next == ~0ULL) return;
+    uint64_t when = next << TICK_SHIFT;
+    uint64_t now = count();
+    while (true) {
+	if (when < now + MIN_DELAY) when = now + MIN_DELAY;
+	set_alarm(uint32_t(when));
+	// the match only happens when the write landed before the counter
+	// reached when, otherwise try again a little later
+	now = count();
+	if (now < when) break;
+    }
+}
+
+Event::~Event() {
+    cancel(this);
+}
+
+void add(Event *event, uint64_t deadline) {
+    IRQ::Guard guard;
+    Locked locked(lock);
+    wheel.add(event, deadline);
+    program();
+}
+
+void add_after(Event *event, uint32_t usec) {
+    add(event, count() + usec);
+}
+
+bool cancel(Event *event) {
+    IRQ::Guard guard;
+    Locked locked(lock);
+    if (!event->pending()) return false;
+    // compare 1 may still fire for it, that only runs an empty pass
+    wheel.remove(event);
+    return true;
+}
+
+static void wake_sleeper(Event *event, void *arg) {
+    (void)event;
+    Sched::wake((Sched::Thread *)arg);
+}
+
+void sleep(uint32_t usec) {
+    Sched::Thread *thread = Sched::current();
+    if (thread == nullptr) {
+	// no scheduler yet
+	busy_wait(usec);
+	return;
+    }
+    Event event(wake_sleeper, thread);
+    add_after(&event, usec);
+    while (event.pending()) {
+	Sched::block();
+    }
+}
+
+void run_wheel() {
+    // IRQs are disabled in the handler
+    lock.lock();
+    armed = ~0ULL;
+    uint64_t tick = count() >> TICK_SHIFT;
+    for (uint32_t fired = 0; fired < MAX_EXPIRE; ++fired) {
+	Event *event = wheel.expire(tick);
+	if (event == nullptr) break;
+	// the callback may add the event again
+	lock.unlock();
+	Wheel::fire(event);
+	lock.lock();
+    }
+    // with events left over the next pass follows right away
+    program();
+    lock.unlock();
+}
+
+CONSTRUCTOR(TIMER_WHEEL) {
+    wheel.init(count() >> TICK_SHIFT);
+    IRQ::enable_irq(IRQ::IRQ_TIMER1);
+} CONSTRUCTOR_END
+
+__END_NAMESPACE(Timer);
+__END_NAMESPACE(Kernel);
@@ -0,0 +1,104 @@
+/* Copyright (C) 2015 Goswin von Brederlow <goswin-v-b@web.de>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+/* Timer wheel
+ *
+ * Kernel timers on top of compare register 1 of the system timer. Pending
+ * events hang in a hierarchical timing wheel of WHEEL_LEVELS levels with
+ * WHEEL_SLOTS slots each. Level 0 slots are one tick of TICK_USEC wide,
+ * every level above is WHEEL_SLOTS times coarser. Adding and cancelling an
+ * event is O(1). A bitmap per level finds the next non-empty slot, only
+ * that time is programmed into the compare register and empty ticks are
+ * skipped. When time reaches a slot of a higher level its events move
+ * down to the finer levels until they expire from level 0.
+ *
+ * Callbacks run in the IRQ of core 0 with IRQs disabled. At most
+ * MAX_EXPIRE callbacks run per IRQ, the rest follow in the next one, so
+ * a burst of timeouts can not stall the core.
+ */
+
+#ifndef KERNEL_WHEEL_H
+#define KERNEL_WHEEL_H 1
+
+#include <stdint.h>
+#include <sys/cdefs.h>
+#include "list.h"
+
+__BEGIN_NAMESPACE(Kernel);
+__BEGIN_NAMESPACE(Timer);
+
+enum {
+    TICK_SHIFT = 4,
+    TICK_USEC = 1U << TICK_SHIFT, // resolution of the wheel
+    WHEEL_BITS = 6,
+    WHEEL_SLOTS = 1U << WHEEL_BITS,
+    WHEEL_LEVELS = 5, // 2^30 ticks, over 4 hours, later events wait above
+    MAX_EXPIRE = 64,
+};
+
+class WheelList;
+
+class Event : public Lists<Event, WheelList> {
+public:
+    typedef void (*Callback)(Event *event, void *arg);
+
+    Event(Callback callback, void *arg)
+	: Lists<Event, WheelList>(this), callback_(callback), arg_(arg),
+	  deadline_(0), slot_(NOT_PENDING) { }
+
+    ~Event();
+
+    // time in micro seconds (see count()) the event fires at
+    uint64_t deadline() const { return deadline_; }
+
+    // added and neither fired nor cancelled yet
+    bool pending() const { return slot_ != NOT_PENDING; }
+private:
+    friend class Wheel;
+
+    Event(const Event &) = delete;
+    Event & operator =(const Event &) = delete;
+
+    enum : uint32_t {
+	NOT_PENDING = ~0U,
+    };
+
+    Callback callback_;
+    void *arg_;
+    uint64_t deadline_;
+    uint32_t slot_; // level * WHEEL_SLOTS + slot in the level
+};
+
+// fire event at deadline (micro seconds), re-adding moves the event
+void add(Event *event, uint64_t deadline);
+
+// fire event usec micro seconds from now
+void add_after(Event *event, uint32_t usec);
+
+// remove a pending event, false when it already fired or was not added
+bool cancel(Event *event);
+
+// block the current thread for at least usec micro seconds
+void sleep(uint32_t usec);
+
+// compare 1 matched, run the expired events
+void run_wheel();
+
+__END_NAMESPACE(Timer);
+__END_NAMESPACE(Kernel);
+
+#endif // ##ifndef KERNEL_WHEEL_H